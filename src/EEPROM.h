@@ -1,6 +1,7 @@
 #include <Arduino.h>
 #include <stdint.h>
 #include <cstring>
+#include <cstddef>
 
 //#define FLASH_PAGE_SIZE 0x2000  // 8 KB page, was 4kB 0x1000 before
 #define FLASH_PAGE_SIZE 0x8000    // 32 KB page, was 8kB 0x1000 before, notably sluggish with 64kB
@@ -10,6 +11,12 @@
 static_assert(EEPROM_PAGE_HEADER_SIZE < FLASH_PAGE_SIZE, "EEPROM header must fit inside a page");
 
 constexpr uint32_t kEepromPageMagic = 0x4550524DL; // 'EPRM'
+// Page state word in the header - each state only clears bits of the previous one
+constexpr uint32_t kPageErased = 0xFFFFFF00u; // Erased ahead of time, ready for rotation
+constexpr uint32_t kPageActive = 0xFFFF0000u;
+constexpr uint32_t kPageStale  = 0x00000000u; // Superseded by a newer page
+#define EEPROM_PARTIAL_ERASE_MS 10 // Duration of one background erase step (ERASEPAGEPARTIAL)
+#define EEPROM_PARTIAL_ERASES    9 // Steps per hardware page, 85 ms erase time in total
 constexpr bool kEnableEepromWrites = true;         // #define DONT_CLEAR_USER_FUNCTIONS on first flashing.
 
 // Wear-leveling diagnostics
@@ -27,11 +34,25 @@ static uint32_t writeCounters[WRITE_COUNTER_SIZE] = {0};
 #define WL_DARKTIME_START 272
 #define WL_DARKTIME_INDEX (WL_DARKTIME_START + WL_DARKTIME_SLOTS)
 
+#ifdef HOST_BUILD // RAM-backed flash of the native build (src/host), addresses are offsets into hostFlash[]
+static inline uint32_t bootloaderStartAddr() {
+    return HOST_FLASH_SIZE;
+}
+
+static inline uint8_t* flashPointer(uint32_t addr) {
+    return hostFlash + addr;
+}
+#else
 static inline uint32_t bootloaderStartAddr() {
     constexpr uint32_t BOOTLOADERADDR_REG = 0x10001014UL;
     return *((volatile uint32_t*)BOOTLOADERADDR_REG);
 }
 
+static inline uint8_t* flashPointer(uint32_t addr) {
+    return reinterpret_cast<uint8_t*>(addr);
+}
+#endif
+
 static inline uint32_t eepromFlashBase() {
     uint32_t pageSize = NRF_FICR->CODEPAGESIZE;
     uint32_t totalSize = pageSize * NRF_FICR->CODESIZE;
@@ -70,8 +91,7 @@ public:
     template <typename T>
     void get(int offset, T& value) {
         ensureInitialized();
-        const uint8_t* src = reinterpret_cast<const uint8_t*>(physicalDataAddress(offset));
-        std::memcpy(&value, src, sizeof(T));
+        std::memcpy(&value, flashPointer(physicalDataAddress(offset)), sizeof(T));
     }
 
     int length() {
@@ -88,8 +108,56 @@ public:
         put(address, val);
     }
 
+    // Bulk programming: one write-mode session, whole words, erased (0xFF) source words skipped.
+    // Bits can only be cleared, so the target range should be erased. Returns words programmed.
+    size_t programRange(int offset, const uint8_t* src, size_t len) {
+        ensureInitialized();
+#if ENABLE_WRITE_COUNTERS
+        for (size_t i = 0; i < len && (offset + i) < WRITE_COUNTER_SIZE; ++i) {
+            writeCounters[offset + i]++;
+        }
+#endif
+        return programBytes(physicalDataAddress(offset), src, len);
+    }
+
+    // programRange() for page images, reports the time taken
+    size_t writeImage(int offset, const uint8_t* src, size_t len) {
+        uint32_t t = micros();
+        size_t words = programRange(offset, src, len);
+        if (Serial) {
+            Serial.print(F("[EEPROM] writeImage offset="));
+            Serial.print(offset);
+            Serial.print(F(" len="));
+            Serial.print(len);
+            Serial.print(F(" words="));
+            Serial.print(words);
+            Serial.print(F(" us="));
+            Serial.println(micros() - t);
+        }
+        return words;
+    }
+
+    // Read-only view of the active page, valid until the next beginPageRewrite()
+    const uint8_t* dataPointer(int offset) {
+        ensureInitialized();
+        return flashPointer(physicalDataAddress(offset));
+    }
+
+    // Commit planner: true if src can be programmed at offset of the active page without an erase,
+    // i.e. no bit has to go from 0 to 1. src == nullptr checks that the range is erased.
+    bool canProgram(int offset, const uint8_t* src, size_t len) {
+        ensureInitialized();
+        const uint8_t* cur = flashPointer(physicalDataAddress(offset));
+        for (size_t i = 0; i < len; ++i) {
+            uint8_t want = src ? src[i] : 0xFF;
+            if ((cur[i] & want) != want) return false;
+        }
+        return true;
+    }
+
     bool beginPageRewrite();
     uint32_t activePageBase() const { return pageBase(activePage); }
+    bool preEraseStep();
 
     // ----- wear-level helpers for small single-byte slots -----
     uint8_t findNextSlot(uint8_t baseAddr, uint8_t numSlots);
@@ -104,7 +172,7 @@ private:
         uint32_t magic;
         uint32_t generation;
         uint32_t generationInverse;
-        uint32_t reserved;
+        uint32_t state; // kPageErased, kPageActive or kPageStale (0xFFFFFFFF on pages of older builds)
     };
 
     void ensureInitialized();
@@ -113,21 +181,25 @@ private:
     uint32_t pageBase(uint8_t idx) const { return poolBaseAddr + static_cast<uint32_t>(idx) * FLASH_PAGE_SIZE; }
     uint32_t dataBase(uint8_t idx) const { return pageBase(idx) + EEPROM_PAGE_HEADER_SIZE; }
     uint32_t physicalDataAddress(int offset) const { return dataBase(activePage) + static_cast<uint32_t>(offset); }
-    void programBytes(uint32_t targetAddr, const uint8_t* src, size_t len);
+    size_t programBytes(uint32_t targetAddr, const uint8_t* src, size_t len);
     void eraseLogicalPage(uint8_t pageIdx);
     bool readHeader(uint8_t pageIdx, PageHeader& out) const;
     void writeHeader(uint8_t pageIdx, uint32_t generation);
     bool rotateToNextPage();
     uint8_t nextPageIndex(uint8_t idx) const { return (idx + 1) % EEPROM_PAGE_POOL; }
+    bool isPreErased(uint8_t pageIdx) const;
+    void writeState(uint8_t pageIdx, uint32_t state);
 
     uint32_t poolBaseAddr;
     uint8_t activePage;
     uint32_t activeGeneration;
     bool initialized;
+    uint8_t preEraseHwPage; // Background erase progress on the next page
+    uint8_t preEraseSteps;
 };
 
 inline EEPROMEmu::EEPROMEmu()
-    : poolBaseAddr(0), activePage(0), activeGeneration(0), initialized(false) {}
+    : poolBaseAddr(0), activePage(0), activeGeneration(0), initialized(false), preEraseHwPage(0), preEraseSteps(0) {}
 
 #if ENABLE_WRITE_COUNTERS
 inline void EEPROMEmu::printWriteStats() {
@@ -165,7 +237,7 @@ inline void EEPROMEmu::initPool() {
     bool found = false;
     uint32_t bestGeneration = 0;
     for (uint8_t i = 0; i < EEPROM_PAGE_POOL; ++i) {
-        if (readHeader(i, hdr)) {
+        if (readHeader(i, hdr) && hdr.state != kPageStale) {
             if (!found || hdr.generation > bestGeneration) {
                 found = true;
                 bestGeneration = hdr.generation;
@@ -188,19 +260,19 @@ inline void EEPROMEmu::initPool() {
 }
 
 inline bool EEPROMEmu::readHeader(uint8_t pageIdx, PageHeader& out) const {
-    const PageHeader* hdr = reinterpret_cast<const PageHeader*>(pageBase(pageIdx));
-    std::memcpy(&out, hdr, sizeof(PageHeader));
+    std::memcpy(&out, flashPointer(pageBase(pageIdx)), sizeof(PageHeader));
     if (out.magic != kEepromPageMagic) return false;
     if (out.generation != (~out.generationInverse)) return false;
     return true;
 }
 
 inline void EEPROMEmu::writeHeader(uint8_t pageIdx, uint32_t generation) {
-    PageHeader hdr{ kEepromPageMagic, generation, ~generation, 0xFFFFFFFFu };
+    PageHeader hdr{ kEepromPageMagic, generation, ~generation, kPageActive };
     programBytes(pageBase(pageIdx), reinterpret_cast<const uint8_t*>(&hdr), sizeof(PageHeader));
 }
 
-inline void EEPROMEmu::programBytes(uint32_t targetAddr, const uint8_t* src, size_t len) {
+inline size_t EEPROMEmu::programBytes(uint32_t targetAddr, const uint8_t* src, size_t len) {
+    size_t programmed = 0;
     if (!kEnableEepromWrites) {
         static uint8_t warned = 0;
         if (Serial && warned < 4) {
@@ -210,7 +282,7 @@ inline void EEPROMEmu::programBytes(uint32_t targetAddr, const uint8_t* src, siz
             Serial.println(len);
             warned++;
         }
-        return;
+        return 0;
     }
 
     uint32_t priorConfig = NRF_NVMC->CONFIG;
@@ -224,7 +296,22 @@ inline void EEPROMEmu::programBytes(uint32_t targetAddr, const uint8_t* src, siz
     while (idx < len) {
         uint32_t addr = targetAddr + idx;
         uint32_t wordAddr = addr & ~0x3UL;
-        uint32_t existingWord = *((uint32_t*)wordAddr);
+        if (addr == wordAddr && len - idx >= 4) { // Whole word - skip erased source words without reading flash
+            uint32_t srcWord;
+            std::memcpy(&srcWord, src + idx, sizeof(srcWord));
+            idx += 4;
+            if (srcWord == 0xFFFFFFFFu) continue;
+            volatile uint32_t* word = reinterpret_cast<volatile uint32_t*>(flashPointer(wordAddr));
+            uint32_t existingWord = *word;
+            if ((existingWord & srcWord) != existingWord) {
+                *word = existingWord & srcWord; // only clear bits
+                while (!NRF_NVMC->READY);
+                programmed++;
+            }
+            continue;
+        }
+        uint32_t existingWord;
+        std::memcpy(&existingWord, flashPointer(wordAddr), sizeof(existingWord));
         uint32_t newWord = existingWord;
 
         size_t byteOffset = addr & 0x3UL;
@@ -242,8 +329,9 @@ inline void EEPROMEmu::programBytes(uint32_t targetAddr, const uint8_t* src, siz
         }
 
         if (newWord != existingWord) {
-            *((volatile uint32_t*)wordAddr) = newWord;
+            *reinterpret_cast<volatile uint32_t*>(flashPointer(wordAddr)) = newWord;
             while (!NRF_NVMC->READY);
+            programmed++;
         }
 
         idx += chunk;
@@ -253,6 +341,7 @@ inline void EEPROMEmu::programBytes(uint32_t targetAddr, const uint8_t* src, siz
         NRF_NVMC->CONFIG = priorConfig;
         while (!NRF_NVMC->READY);
     }
+    return programmed;
 }
 
 inline void EEPROMEmu::eraseLogicalPage(uint8_t pageIdx) {
@@ -280,12 +369,64 @@ inline void EEPROMEmu::eraseLogicalPage(uint8_t pageIdx) {
     }
 }
 
+inline bool EEPROMEmu::isPreErased(uint8_t pageIdx) const {
+    PageHeader hdr;
+    std::memcpy(&hdr, flashPointer(pageBase(pageIdx)), sizeof(PageHeader));
+    return hdr.magic == 0xFFFFFFFFu && hdr.state == kPageErased;
+}
+
+inline void EEPROMEmu::writeState(uint8_t pageIdx, uint32_t state) {
+    programBytes(pageBase(pageIdx) + offsetof(PageHeader, state), reinterpret_cast<const uint8_t*>(&state), sizeof(state));
+}
+
 inline bool EEPROMEmu::rotateToNextPage() {
     uint8_t next = nextPageIndex(activePage);
-    eraseLogicalPage(next);
+    if (!isPreErased(next)) eraseLogicalPage(next); // Background erase not finished
+    uint8_t old = activePage;
     activePage = next;
     activeGeneration = (activeGeneration == 0xFFFFFFFFu) ? 1 : activeGeneration + 1;
     writeHeader(activePage, activeGeneration);
+    writeState(old, kPageStale);
+    preEraseHwPage = preEraseSteps = 0;
+    return true;
+}
+
+// One partial erase step on the page after the active one, for idle time.
+// Returns false if there is nothing to do (next page already erased).
+inline bool EEPROMEmu::preEraseStep() {
+    ensureInitialized();
+    if (!kEnableEepromWrites) return false;
+    uint8_t next = nextPageIndex(activePage);
+    if (isPreErased(next)) return false;
+
+    uint32_t hardwarePageSize = NRF_FICR->CODEPAGESIZE;
+    if (preEraseHwPage < FLASH_PAGE_SIZE / hardwarePageSize) {
+        uint32_t priorConfig = NRF_NVMC->CONFIG;
+        bool switchedMode = (priorConfig != NVMC_CONFIG_WEN_Een);
+        if (switchedMode) {
+            NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een;
+            while (!NRF_NVMC->READY);
+        }
+        NRF_NVMC->ERASEPAGEPARTIALCFG = EEPROM_PARTIAL_ERASE_MS;
+        NRF_NVMC->ERASEPAGEPARTIAL = pageBase(next) + preEraseHwPage * hardwarePageSize;
+        while (!NRF_NVMC->READY);
+        if (switchedMode) {
+            NRF_NVMC->CONFIG = priorConfig;
+            while (!NRF_NVMC->READY);
+        }
+        if (++preEraseSteps >= EEPROM_PARTIAL_ERASES) {
+            preEraseSteps = 0;
+            preEraseHwPage++;
+        }
+        return true;
+    }
+
+    preEraseHwPage = 0; // All hardware pages done - verify before marking
+    const uint8_t* p = flashPointer(pageBase(next));
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE; ++i) {
+        if (p[i] != 0xFF) return true; // Not blank yet, start over
+    }
+    writeState(next, kPageErased);
     return true;
 }
 
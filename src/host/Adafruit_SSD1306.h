@@ -0,0 +1,35 @@
+// Host framebuffer in place of the SSD1306 driver, same page layout (x + (y/8)*128)
+#pragma once
+#include <Adafruit_GFX.h>
+
+#define SSD1306_SWITCHCAPVCC 2
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+#define SSD1306_WHITE 1
+#define SSD1306_BLACK 0
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+
+class Adafruit_SSD1306 {
+public:
+  uint8_t buffer[128 * 64 / 8];
+  unsigned long displays = 0; // Number of display() transfers
+  Adafruit_SSD1306(int, int, int, int, int, int, int) { clearDisplay(); }
+  bool begin(int = 0) { return true; }
+  void clearDisplay() { memset(buffer, 0, sizeof buffer); }
+  void drawPixel(int16_t x, int16_t y, uint16_t c) {
+    if (x < 0 || x >= 128 || y < 0 || y >= 64) return;
+    if (c) buffer[x + (y / 8) * 128] |= 1 << (y & 7);
+    else buffer[x + (y / 8) * 128] &= ~(1 << (y & 7));
+  }
+  void display() { displays++; }
+  uint8_t* getBuffer() { return buffer; }
+  void ssd1306_command(uint8_t) {}
+  void setTextSize(int) {}
+  void setTextColor(int) {}
+  void setCursor(int, int) {}
+  void cp437(bool) {}
+  size_t write(const char*) { return 0; }
+  int16_t width() const { return 128; }
+  int16_t height() const { return 64; }
+};
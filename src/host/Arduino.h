@@ -0,0 +1,117 @@
+// Host (Linux) stand-in for the Arduino/nRF52 API used by main.cpp and EEPROM.h.
+// Only the calls the calculator core makes are provided; see host.cpp.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <ctype.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+#define PROGMEM
+#define F(x) (x)
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 3
+#define FALLING 2
+#define HEX 16
+#define DEC 10
+#define MSBFIRST 1
+template <class T, class L> auto min(const T& a, const L& b) -> decltype((b < a) ? b : a) { return (b < a) ? b : a; }
+template <class T, class L> auto max(const T& a, const L& b) -> decltype((b < a) ? b : a) { return (a < b) ? b : a; }
+
+// Clock - real time plus everything skipped by delay()
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void delayMicroseconds(unsigned int);
+unsigned long hostMicros(); // Wall clock without the skipped delays, for timing on the host
+
+// Keys - 4x4 matrix and MAGICKEYPIN, driven by hostKey (see host.cpp)
+extern char hostKey;
+void pinMode(uint32_t, uint32_t);
+void digitalWrite(uint32_t, uint32_t);
+int digitalRead(uint32_t);
+int analogRead(uint32_t);
+void attachInterrupt(uint32_t, void (*)(), int);
+void detachInterrupt(uint32_t);
+inline void shiftOut(uint32_t, uint32_t, uint32_t, uint8_t) {} // Display data - the framebuffer is read directly
+inline void __WFE() {}
+inline void __SEV() {}
+#define PIN_002 2
+#define PIN_009 9
+#define PIN_010 10
+#define PIN_011 11
+#define PIN_017 17
+#define PIN_020 20
+#define PIN_022 22
+#define PIN_024 24
+#define PIN_029 29
+#define PIN_031 31
+#define PIN_100 32
+#define PIN_106 38
+#define PIN_111 43
+#define PIN_113 45
+#define PIN_115 47
+
+// Serial - written to stdout while enabled
+struct HostSerial {
+  bool enabled = true;
+  explicit operator bool() const { return enabled; }
+  void begin(long) {}
+  template <typename T> size_t print(T v) { if (enabled) fputs(fmt(v).c_str(), stdout); return 0; }
+  template <typename T> size_t print(T v, int b) { if (enabled) fputs(fmt(v, b).c_str(), stdout); return 0; }
+  template <typename T> size_t println(T v) { print(v); return println(); }
+  template <typename T> size_t println(T v, int b) { print(v, b); return println(); }
+  size_t println() { if (enabled) fputc('\n', stdout); return 0; }
+  size_t printf(const char* f, ...) { if (!enabled) return 0; va_list a; va_start(a, f); vprintf(f, a); va_end(a); return 0; }
+  size_t write(uint8_t c) { if (enabled) fputc(c, stdout); return 1; }
+  size_t write(const char* s, size_t n) { if (enabled) fwrite(s, 1, n, stdout); return n; }
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush() { fflush(stdout); }
+  static std::string fmt(const char* s) { return s ? s : "(null)"; }
+  static std::string fmt(char c) { return std::string(1, c); }
+  static std::string fmt(double d, int p = 2) { char b[64]; snprintf(b, sizeof b, "%.*f", p, d); return b; }
+  static std::string fmt(float d, int p = 2) { return fmt((double)d, p); }
+  template <typename T> static std::string fmt(T v, int base = 10) {
+    char b[64];
+    if (base == HEX) snprintf(b, sizeof b, "%llX", (unsigned long long)v);
+    else snprintf(b, sizeof b, "%lld", (long long)v);
+    return b;
+  }
+};
+extern HostSerial Serial;
+
+// Flash - NVMC writes go to hostFlash[], addresses are offsets into it
+#define HOST_FLASH_SIZE 0x40000 // EEPROM_PAGE_POOL * FLASH_PAGE_SIZE
+extern uint8_t hostFlash[HOST_FLASH_SIZE];
+struct HostErasePage { HostErasePage& operator=(uint32_t addr); };
+struct NRF_NVMC_Type {
+  volatile uint32_t CONFIG;
+  volatile uint32_t READY;
+  HostErasePage ERASEPAGE;
+  HostErasePage ERASEPAGEPARTIAL; // Erases the whole page at once on the host
+  volatile uint32_t ERASEPAGEPARTIALCFG;
+};
+struct NRF_FICR_Type { uint32_t CODEPAGESIZE; uint32_t CODESIZE; };
+struct NRF_CLOCK_Type { uint32_t TASKS_HFCLKSTART; uint32_t EVENTS_HFCLKSTARTED; };
+extern NRF_NVMC_Type* NRF_NVMC;
+extern NRF_FICR_Type* NRF_FICR;
+extern NRF_CLOCK_Type* NRF_CLOCK;
+#define NVMC_CONFIG_WEN_Ren 0
+#define NVMC_CONFIG_WEN_Wen 1
+#define NVMC_CONFIG_WEN_Een 2
+extern uint32_t SystemCoreClock;
+inline void SystemCoreClockUpdate() {}
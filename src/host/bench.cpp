@@ -0,0 +1,197 @@
+// Native benchmark - runs the README examples on the host build and reports the time per run.
+// Build and run with: pio run -e native -t exec
+#include "../main.cpp"
+#include <initializer_list>
+
+#define BENCHRUNS 20
+
+static void benchprogram(const char* name, std::initializer_list<byte> code) { // Make code the only user program
+  uint8_t image[256];
+  int n = 0;
+  image[n++] = _END; // Leading sentinel of the program list
+  for (byte i = 0; i < PRGNAMEMAX; i++) image[n++] = name[i];
+  for (byte c : code) image[n++] = c;
+  image[n++] = _END; image[n++] = _END; // End of program and of program list
+  rewriteUserAreaImage(image, n, "bench");
+  sort();
+}
+
+static void benchprograms(std::initializer_list<std::pair<const char*, std::initializer_list<byte>>> prgs) { // Make prgs the user programs
+  uint8_t image[512];
+  int n = 0;
+  image[n++] = _END;
+  for (auto& p : prgs) {
+    for (byte i = 0; i < PRGNAMEMAX; i++) image[n++] = p.first[i];
+    for (byte c : p.second) image[n++] = c;
+    image[n++] = _END;
+  }
+  image[n++] = _END;
+  rewriteUserAreaImage(image, n, "bench");
+  sort();
+}
+
+static void benchrun(void) { // Run the program started with execute() to its end
+  for (unsigned long steps = 0; mp && steps < 1000000UL; steps++) runstep();
+}
+
+static void benchreset(void) { // Empty stacks and number entry state
+  dp = ap = mp = 0;
+  msgnr = 0;
+  decimals = 0; isdot = false; isnewnumber = true;
+}
+
+static void benchreport(const char* name, unsigned long us, const char* result) {
+  printf("%-9s %10.1f us/run  %s\n", name, (double)us / BENCHRUNS, result);
+}
+
+static void benchintegral(void) { // README: int(-128..128) [u(u^2-47^2)(u^2-88^2)(u^2-117^2)]^2 du = 1.31026895247E28
+  commitConstantSlot(97, {47.0 * 47.0, 0.0, 0LL});
+  commitConstantSlot(98, {88.0 * 88.0, 0.0, 0LL});
+  commitConstantSlot(99, {117.0 * 117.0, 0.0, 0LL});
+  benchprogram("HPJ", {_1, _STO_RAM, _CLR, _1, _RCL_RAM, _2, _POW, _9, _9, _RCL, _SUB, _1, _RCL_RAM, _2, _POW, _9, _8, _RCL, _SUB, _MULT,
+                       _1, _RCL_RAM, _2, _POW, _9, _7, _RCL, _SUB, _MULT, _1, _RCL_RAM, _MULT, _2, _POW});
+  unsigned long t = hostMicros();
+  for (byte i = 0; i < BENCHRUNS; i++) {
+    benchreset();
+    dpushr(-128.0); dpushr(128.0);
+    _fnintegrate();
+  }
+  t = hostMicros() - t;
+  char s[64];
+  snprintf(s, sizeof s, "FINT=%.11g err=%.3g", dp ? ds[dp - 1].r : NAN, dp > 1 ? ds[dp - 2].r : NAN);
+  benchreport("integral", t, s);
+}
+
+static void benchsolve(void) { // README: TVM i=0.08 PV=1000 PMT=-100 FV=0, FSOLVE for n = 20.921237
+  commitConstantSlot(0, {0.08, 0.0, 0LL});
+  commitConstantSlot(1, {1000.0, 0.0, 0LL});
+  commitConstantSlot(2, {-100.0, 0.0, 0LL});
+  commitConstantSlot(3, {0.0, 0.0, 0LL});
+  benchprogram("TVM", {_0, _STO_RAM, _CLR, _0, _RCL, _1, _ADD, _0, _RCL_RAM, _POW, _1, _RCL, _MULT, _0, _RCL, _1, _ADD, _0, _RCL_RAM, _POW,
+                       _1, _SUB, _0, _RCL, _DIV, _2, _RCL, _MULT, _ADD, _3, _RCL, _SUB});
+  unsigned long t = hostMicros();
+  for (byte i = 0; i < BENCHRUNS; i++) {
+    benchreset();
+    dpushr(10.0); dpushr(30.0); // Start interval
+    _fnsolve();
+    while (issolve) {
+      delay(1000); // Skip the frame wait of loop()
+      loop();
+    }
+  }
+  t = hostMicros() - t;
+  char s[64];
+  snprintf(s, sizeof s, "n=%.10g", dp ? ds[dp - 1].r : NAN);
+  benchreport("solve", t, s);
+}
+
+static void benchplot(void) { // README: ln plotted from 0 to 2
+  benchprogram("LN ", {_LN});
+  unsigned long t = hostMicros();
+  for (byte i = 0; i < BENCHRUNS; i++) {
+    benchreset();
+    dpushr(0.0); dpushr(2.0);
+    _fnplot();
+    printscreen();
+  }
+  t = hostMicros() - t;
+  int pixels = 0;
+  for (unsigned int i = 0; i < sizeof(oled.buffer); i++) pixels += __builtin_popcount(oled.buffer[i]);
+  char s[64];
+  snprintf(s, sizeof s, "pixels=%d frames=%lu flushes=%lu pages=%lu", pixels, oledframes, oledflushes, oledpagessent);
+  benchreport("plot", t, s);
+}
+
+static void benchbranch(void) { // Count down from 200 past a long IF branch that is never taken
+  benchprogram("BRN", {_BEGIN, _DUP, _0, _LT, _IF,
+                       _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP,
+                       _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP, _DUP, _DROP,
+                       _ELSE, _THEN, _1, _SUB, _DUP, _0, _EQ, _UNTIL});
+  unsigned long t = hostMicros();
+  for (byte i = 0; i < BENCHRUNS; i++) {
+    benchreset();
+    dpushr(200.0);
+    execute(MAXCMDB);
+    while (mp) runstep();
+  }
+  t = hostMicros() - t;
+  char s[64];
+  snprintf(s, sizeof s, "x=%g dp=%d ap=%d", dp ? ds[dp - 1].r : NAN, dp, ap);
+  benchreport("branch", t, s);
+}
+
+static void benchcomplex(void) { // Complex DIV and INV on extreme magnitudes, where |b|^2 would under- or overflow
+  static const struct data cases[][3] = { // Dividend, divisor, expected quotient
+    {{1.0, 2.0, 0LL}, {3.0, -4.0, 0LL}, {-0.2, 0.4, 0LL}},
+    {{1e-160, 0.0, 0LL}, {1e-160, 1e-160, 0LL}, {0.5, -0.5, 0LL}},
+    {{1e-300, 1e-300, 0LL}, {1e-300, 2e-300, 0LL}, {0.6, -0.2, 0LL}},
+    {{1e98, 1e98, 0LL}, {1e98, -1e98, 0LL}, {0.0, 1.0, 0LL}},
+    {{1.0, 0.0, 0LL}, {1e98, 1e98, 0LL}, {5e-99, -5e-99, 0LL}},
+  };
+  const byte n = sizeof cases / sizeof cases[0];
+  byte ok = 0;
+  unsigned long t = hostMicros();
+  for (byte i = 0; i < BENCHRUNS; i++) {
+    ok = 0;
+    for (byte c = 0; c < n; c++) {
+      benchreset();
+      dpush(cases[c][0]); dpush(cases[c][1]);
+      _div();
+      dpush(ds[0]);
+      _inv(); _inv(); // 1/(1/q) == q
+      dpush({0.5, 0.5, 0LL}); _tan(); _atan(); _tanh(); _drop();
+      const struct data& e = cases[c][2];
+      double tol = 1e-12 * (_abs(e.r) + _abs(e.i));
+      if (!msgnr && dp == 2 && _abs(ds[0].r - e.r) <= tol && _abs(ds[0].i - e.i) <= tol
+          && _abs(ds[1].r - e.r) <= tol && _abs(ds[1].i - e.i) <= tol) ok++;
+    }
+  }
+  t = hostMicros() - t;
+  char s[64];
+  snprintf(s, sizeof s, "ok=%d/%d", ok, n);
+  benchreport("complex", t, s);
+}
+
+static double benchnestedcase(byte prg, boolean isplotted = false) { // Run user program prg, TOS if it left exactly one clean level
+  benchreset();
+  isplot = false;
+  execute(prg);
+  benchrun();
+  return (mp || ap || msgnr || dp != 1 || isplot != isplotted) ? NAN : ds[0].r;
+}
+
+static void benchnested(void) { // FINT and FPLOT from a loop and from a subroutine - f(x) must not return into the caller
+  static const std::initializer_list<byte> loop = {_BEGIN, _0, _DUP, _3, _FINT, _SWAP, _DROP, _1, _UNTIL};
+  static const std::initializer_list<byte> sub = {_0, _DUP, _3, _FINT, _SWAP, _DROP};
+  static const std::initializer_list<byte> ploop = {_BEGIN, _0, _DUP, _3, _FPLOT, _1, _UNTIL, _7};
+  static const std::initializer_list<byte> psub = {_0, _DUP, _3, _FPLOT};
+  double r[6];
+  unsigned long t = hostMicros();
+  for (byte i = 0; i < BENCHRUNS; i++) {
+    benchprograms({{"SQR", {_DUP, _MULT}}, {"LOP", loop}, {"SUB", sub}, {"CAL", {MAXCMDB + 2, _1, _ADD}}});
+    r[0] = benchnestedcase(MAXCMDB + 1);
+    r[1] = benchnestedcase(MAXCMDB + 3);
+    benchprograms({{"SQR", {_DUP, _MULT}}, {"PLO", ploop}, {"PSB", psub}, {"PCA", {MAXCMDB + 2, _7}}});
+    r[3] = benchnestedcase(MAXCMDB + 1, true);
+    r[4] = benchnestedcase(MAXCMDB + 3, true);
+    benchprograms({{"SLO", {_6, _0, _0, _BEGIN, _1, _SUB, _DUP, _0, _EQ, _UNTIL, _DROP, _DUP, _MULT}}, {"LOP", loop}, {"PLO", ploop}}); // ~3600 steps per f(x)
+    r[2] = benchnestedcase(MAXCMDB + 1);
+    r[5] = benchnestedcase(MAXCMDB + 2, true);
+  }
+  t = hostMicros() - t;
+  char s[64];
+  snprintf(s, sizeof s, "loop=%.6g sub=%.6g long=%.6g plot %.6g %.6g %.6g", r[0], r[1], r[2], r[3], r[4], r[5]);
+  benchreport("nested", t, s);
+}
+
+int main(int argc, char** argv) {
+  Serial.enabled = argc > 1 && !strcmp(argv[1], "-v"); // -v shows the serial log
+  setup();
+  benchintegral();
+  benchsolve();
+  benchplot();
+  benchcomplex();
+  benchbranch();
+  benchnested();
+  return 0;
+}
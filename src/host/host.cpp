@@ -0,0 +1,55 @@
+// Host implementation of the platform calls declared in host/Arduino.h
+#include <Arduino.h>
+#include <chrono>
+
+HostSerial Serial;
+uint32_t SystemCoreClock = 64000000;
+
+// Flash - 4 KB hardware pages, erased state 0xFF
+uint8_t hostFlash[HOST_FLASH_SIZE];
+static NRF_NVMC_Type nvmc{NVMC_CONFIG_WEN_Ren, 1, {}, {}, 10};
+static NRF_FICR_Type ficr{4096, HOST_FLASH_SIZE / 4096};
+static NRF_CLOCK_Type clk{0, 1};
+NRF_NVMC_Type* NRF_NVMC = &nvmc;
+NRF_FICR_Type* NRF_FICR = &ficr;
+NRF_CLOCK_Type* NRF_CLOCK = &clk;
+
+HostErasePage& HostErasePage::operator=(uint32_t addr) {
+  if (addr + ficr.CODEPAGESIZE <= HOST_FLASH_SIZE) memset(hostFlash + addr, 0xFF, ficr.CODEPAGESIZE);
+  return *this;
+}
+
+__attribute__((constructor)) static void hostflashinit() { memset(hostFlash, 0xFF, sizeof hostFlash); }
+
+// Clock - delay() only advances the clock, so boot screens and key debouncing cost no wall time
+static const auto hoststart = std::chrono::steady_clock::now();
+static unsigned long hostskipped; // ms
+
+unsigned long hostMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - hoststart).count();
+}
+unsigned long micros() { return hostskipped * 1000UL + hostMicros(); }
+unsigned long millis() { return micros() / 1000UL; }
+void delay(unsigned long ms) { hostskipped += ms; }
+void delayMicroseconds(unsigned int) {}
+
+// Keys - hostKey holds the character of the key held down (0 = none, '?' = MAGICKEYPIN)
+char hostKey;
+static const uint32_t cols[4] = {PIN_009, PIN_010, PIN_111, PIN_113};
+static const uint32_t rows[4] = {PIN_115, PIN_002, PIN_029, PIN_011};
+static const char keymatrix[4][4] = {{0, '7', '8', '9'}, {'>', '4', '5', '6'}, {'=', '1', '2', '3'}, {'<', '0', ':', ';'}};
+static uint8_t level[64];
+
+void pinMode(uint32_t pin, uint32_t mode) { if (pin < 64 && mode != OUTPUT) level[pin] = HIGH; }
+void digitalWrite(uint32_t pin, uint32_t val) { if (pin < 64) level[pin] = val; }
+int digitalRead(uint32_t pin) {
+  if (pin == PIN_106) return hostKey == '?' ? LOW : HIGH;
+  for (byte r = 0; r < 4; r++)
+    if (rows[r] == pin)
+      for (byte c = 0; c < 4; c++)
+        if (level[cols[c]] == LOW && hostKey && keymatrix[r][c] == hostKey) return LOW;
+  return HIGH;
+}
+int analogRead(uint32_t) { return 600; } // Battery divider at about 3.9 V
+void attachInterrupt(uint32_t, void (*)(), int) {}
+void detachInterrupt(uint32_t) {}
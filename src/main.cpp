@@ -412,7 +412,7 @@ Ivee2 is operated by 16 keys only it offers a wide range of functions
       (2 x double, int64)                (int)                 POINTER
     |      |      |       |             |     |
     |______|______|_______|             |_____|               <cp (byte)
-    |______|______|_______|<dp (byte)   |_____|
+    |______|______|_______|<dp (int)    |_____|
     |______|______|_______|             |_____|<ap (int)
     |__re__|__im__|_int64_|             |_____|
              ds[]                         as[]
@@ -551,9 +551,28 @@ unknown to me.
 #ifndef LOG_PLOT // Enable logging of plotting pipeline diagnostics
 #define LOG_PLOT 0
 #endif
+#ifndef LOG_FRAMES // Enable logging of screen frame and flush counters
+#define LOG_FRAMES 0
+#endif
+#ifndef LOG_VERIFY // Enable logging of the stack effect of saved and loaded programs
+#define LOG_VERIFY 0
+#endif
 #ifndef SHOW_BUILD_SCREEN
 #define SHOW_BUILD_SCREEN 1
 #endif
+#ifndef PLOT_PROGRESSIVE // Redraw the partial graph while FPLOT is still sampling
+#define PLOT_PROGRESSIVE 0
+#endif
+#ifndef MATH_COMPARE // Compare native math builtins with their mem[] definitions at startup
+#define MATH_COMPARE 0
+#endif
+#ifndef THREADED_CODE // Run programs from pre-decoded cells instead of fetching and dispatching bytes
+#define THREADED_CODE 1
+#endif
+#if LOG_PRG_MEMPTR || LOG_FX_FI_STACK // Step logging lives in the byte interpreter
+#undef THREADED_CODE
+#define THREADED_CODE 0
+#endif
 
 // Compiler flag to preserve user functions on startup
 // By default, user functions are cleared on startup to prevent gibberish.
@@ -742,19 +761,24 @@ Adafruit_SSD1306 oled(SCREEN_WIDTH, SCREEN_HEIGHT,
 // VARIABLES
 static byte dbuf[SCREENBYTES]; // Buffer for virtual screen (costs 256 bytes of dynamic memory)
 static byte graphbuf[GRAPHBUF_BYTES]; // Full-resolution graph overlay buffer (1,024 bytes)
-static byte eachframemillis, thisframestart, lastframedurationms; // Framing times
-static boolean justrendered; // True if frame was just rendered
+static byte eachframemillis; // Minimum time between two redraws
+static unsigned long lastkeyscan, lasttick, lastredraw; // Times of last event of each source
 static boolean isscreensave = false; // True if screensaver is active
 static long powertimestamp = 0; // Needed for timing of power manangement
 
 static byte brightness;  // declare only 
 static boolean graph_dirty = false; // Tracks whether the high-res graph buffer has content
+static byte oledpages; // Oled pages changed since the last transfer (one bit per page)
+static unsigned long oledpagessent; // Pages transmitted to the oled
+static unsigned long oledflushes, oledframes; // Calls of flush_dbuf_to_oled() and printscreen()
 
 // FORWARD DECLARATIONS
 static void delayshort(byte);
 static byte expand4bit(byte);
 static int userAreaCapacity(void);
 static void sort(void);
+static void savedir(void);
+static boolean loaddir(void);
 static bool rewriteUserAreaImage(const uint8_t*, int, const char*, uint8_t* overrideConfig = nullptr);
 static double dpoprd(void);
 
@@ -768,23 +792,6 @@ static void screenoff(void) {
   digitalWrite(PIN_RST, LOW);                // Optional: reset low for power save
 }
 
-static void drawGraphOverlay(void) {
-  if (!graph_dirty) return;
-  const byte pages = GRAPH_PIXEL_HEIGHT / 8;
-  for (byte page = 0; page < pages; ++page) {
-    for (byte x = 0; x < GRAPH_PIXEL_WIDTH; ++x) {
-      byte column = graphbuf[x + page * GRAPH_PIXEL_WIDTH];
-      if (!column) continue;
-      for (byte bit = 0; bit < 8; ++bit) {
-        if (column & (1 << bit)) {
-          int y = page * 8 + bit;
-          oled.drawPixel(x, y, SSD1306_WHITE);
-        }
-      }
-    }
-  }
-}
-
 static void screenon(void) {
   digitalWrite(PIN_RST, HIGH);               // Reset high
   delayshort(5);
@@ -794,33 +801,56 @@ static void screenon(void) {
   }
   
   oled.ssd1306_command(SSD1306_DISPLAYON);   // 0xAF - turn display back on
+  oledpages = 0xff; // Display RAM was reset - send all pages on next flush
 }
 
-void flush_dbuf_to_oled() {
-  oled.clearDisplay();
+static const byte expand4[16] = { // expand4bit() of every nibble
+  0x00, 0x03, 0x0c, 0x0f, 0x30, 0x33, 0x3c, 0x3f, 0xc0, 0xc3, 0xcc, 0xcf, 0xf0, 0xf3, 0xfc, 0xff
+};
+
+static void oledsend(void) { // Transmit changed pages of the oled buffer
+  const byte* buf = oled.getBuffer();
+  for (byte p = 0; p < SCREEN_HEIGHT / 8; p++) {
+    if (!(oledpages & (1 << p))) continue;
+    oled.ssd1306_command(SSD1306_PAGEADDR);
+    oled.ssd1306_command(p);
+    oled.ssd1306_command(p);
+    oled.ssd1306_command(SSD1306_COLUMNADDR);
+    oled.ssd1306_command(0);
+    oled.ssd1306_command(SCREEN_WIDTH - 1);
+    digitalWrite(PIN_DC, HIGH); // Data mode
+    digitalWrite(PIN_CS, LOW);
+    for (byte x = 0; x < SCREEN_WIDTH; x++) shiftOut(PIN_MOSI, PIN_SCK, MSBFIRST, buf[x + p * SCREEN_WIDTH]);
+    digitalWrite(PIN_CS, HIGH);
+    oledpagessent++;
+  }
+  oledpages = 0;
+}
+
+void flush_dbuf_to_oled() { // Expand dbuf[] 2x into the oled page layout, add the graph and send changed pages
+  byte* buf = oled.getBuffer();
   for (byte l = 0; l < MAXLIN; l++) {       // 0..3 lines (each line = 8 pixels vertical)
-    for (byte k = 0; k < 2; k++) {          // 0..1 nibbles (each nibble = 4 vertical pixels)
+    for (byte k = 0; k < 2; k++) {          // 0..1 nibbles (each nibble = one 8 pixel oled page)
+      byte p = l * 2 + k;
+      byte* row = buf + p * SCREEN_WIDTH;
+      const byte* graph = graphbuf + p * GRAPH_PIXEL_WIDTH;
+      byte changed = 0;
       for (byte j = 0; j < SCREENWIDTH; j++) {  // 0..63 columns in virtual space
-        byte nibble = (dbuf[j + l * SCREENWIDTH] >> (k * 4)) & 0x0f;
-        byte pattern = expand4bit(nibble);  // Convert nibble to 8-pixel vertical pattern
-
-        for (byte bit = 0; bit < 8; bit++) {
-          bool on = pattern & (1 << bit);
-
-          // Calculate x & y
-          int x = j * 2;
-          int y = l * 8 * 2 + k * 8 + bit;
-
-          if (on) {
-            oled.drawPixel(x, y, SSD1306_WHITE);
-            oled.drawPixel(x + 1, y, SSD1306_WHITE);
-          }
+        byte pattern = expand4[(dbuf[j + l * SCREENWIDTH] >> (k * 4)) & 0x0f];
+        byte b0 = pattern, b1 = pattern;
+        if (graph_dirty) {
+          b0 |= graph[2 * j];
+          b1 |= graph[2 * j + 1];
         }
+        changed |= (row[2 * j] ^ b0) | (row[2 * j + 1] ^ b1);
+        row[2 * j] = b0;
+        row[2 * j + 1] = b1;
       }
+      if (changed) oledpages |= 1 << p;
     }
   }
-  drawGraphOverlay();
-  oled.display();
+  oledflushes++;
+  oledsend();
 }
 
 const char* skipLeading(const char* s) {
@@ -861,6 +891,7 @@ const char* skipLeading(const char* s) {
 
 #define PRINTNOKEY   254 // Only evaluate keys smaller
 #define NOPRINTNOKEY 255 // Evaluate keys smaller
+#define KEYSCANMS     20 // Time in ms between key scans (debounce needs two equal scans)
 
 // VARIABLES
 static byte key = PRINTNOKEY; // Holds entered key
@@ -885,39 +916,126 @@ static void _asinh(void), _acosh(void), _h2hms(void), _frac(void), _cvdeg2rad(vo
 static void _cvkm2mi(void), _cvm2ft(void), _cvcm2in(void), _cvkg2lbs(void), _cvl2gal(void), _condseek(void);
 static void _numinput(byte);
 static bool runImmediateProgram(uint16_t maxSteps = 0);
-static bool evaluateFxImmediate(double x, double& fx);
+static bool evaluateFxImmediate(double x, double& fx, uint16_t maxSteps = 0);
 static void _mstorcl_ram(boolean issto); // RAM storage functions
 static void _sto_ram(void); // STO-RAM wrapper
 static void _rcl_ram(void); // RCL-RAM wrapper
 static int apop(void), apush(void), seekusr(byte);
 
 // SUBPROGRAMS
-static byte getkey() {
+static const byte keycols[4] = {KEYBOARDCOL1, KEYBOARDCOL2, KEYBOARDCOL3, KEYBOARDCOL4}; // Pins
+static const byte keyrows[4] = {KEYBOARDROW1, KEYBOARDROW2, KEYBOARDROW3, KEYBOARDROW4};
+static const char keymatrix[4][4] = {
+  {'\0', KEY2, KEY3, KEY4}, // was NULL - F-key has its own pin
+  {KEY5, KEY6, KEY7, KEY8},
+  {KEY9, KEY10, KEY11, KEY12},
+  {KEY13, KEY14, KEY15, KEY16},
+};
+
+#define KEYQUEUE 16 // Size of key event queue (power of 2)
+static struct keyevent {
+  byte key; // Key that changed
+  boolean down; // Pressed or released
+  unsigned long ms; // Time of the debounced change
+} keyq[KEYQUEUE];
+static byte keyqhead, keyqtail; // Queue write and read index
+static byte keylast = NOPRINTNOKEY, keystable = NOPRINTNOKEY; // Key of last scan, debounced key
+static byte keylevel = NOPRINTNOKEY; // Key held after the events taken by getkey()
+static unsigned long keyscanms, keydownms; // Time of last scan, of the last key press taken
+static volatile boolean keysensed; // A row went low - scan without waiting
+static boolean keyabort; // C pressed and not taken yet - see abortRequested()
+
+static void keysense(void) { // Row interrupt
+  keysensed = true;
+}
+
+static void keyinit(void) { // Drive all columns low, so any key pulls its row low and wakes the CPU
   pinMode(MAGICKEYPIN, INPUT_PULLUP);
+  for (byte r = 0; r < 4; r++) {
+    pinMode(keyrows[r], INPUT_PULLUP);
+    attachInterrupt(keyrows[r], keysense, FALLING);
+  }
+  for (byte c = 0; c < 4; c++) {
+    pinMode(keycols[c], OUTPUT);
+    digitalWrite(keycols[c], LOW);
+  }
+}
+
+static byte keyscan(void) { // Key held down now
   if (!digitalRead(MAGICKEYPIN)) return (KEY1); // F-key pressed
-  byte pinscol[4] = {KEYBOARDCOL1, KEYBOARDCOL2, KEYBOARDCOL3, KEYBOARDCOL4}; // Pins
-  byte pinsrow[4] = {KEYBOARDROW1, KEYBOARDROW2, KEYBOARDROW3, KEYBOARDROW4};
-  char k[4][4] = {
-    {'\0', KEY2, KEY3, KEY4}, // was NULL
-    {KEY5, KEY6, KEY7, KEY8},
-    {KEY9, KEY10, KEY11, KEY12},
-    {KEY13, KEY14, KEY15, KEY16},
-  };
+  byte r = 0;
+  while (r < 4 && digitalRead(keyrows[r])) r++;
+  if (r == 4) return (NOPRINTNOKEY); // No row low - no key
   byte kee = NOPRINTNOKEY;
-  for (byte r = 0; r < 4; r++) pinMode(pinsrow[r], INPUT_PULLUP); // Set rows to Vcc
-  for (byte c = 0; c < 4; c++) {
-    pinMode(pinscol[c], OUTPUT); // Set cols as OUTPUT and to GND
-    digitalWrite(pinscol[c], LOW);
-    for (byte r = 0; r < 4; r++) if (!digitalRead(pinsrow[r])) kee = (k[r][c]); //Assign key
-    digitalWrite(pinscol[c], HIGH); // Reset cols to Vcc and INPUT
+  for (byte c = 0; c < 4; c++) digitalWrite(keycols[c], HIGH);
+  for (byte c = 0; c < 4; c++) { // Drive one column at a time
+    digitalWrite(keycols[c], LOW);
+    for (r = 0; r < 4; r++) if (!digitalRead(keyrows[r]) && keymatrix[r][c]) kee = keymatrix[r][c]; //Assign key
+    digitalWrite(keycols[c], HIGH);
   }
+  for (byte c = 0; c < 4; c++) digitalWrite(keycols[c], LOW); // Back to sensing
   return (kee);
 }
 
+static void keyqueue(byte k, boolean down, unsigned long ms) { // Append key event - dropped if queue is full
+  byte next = (keyqhead + 1) & (KEYQUEUE - 1);
+  if (next == keyqtail) return;
+  keyq[keyqhead].key = k;
+  keyq[keyqhead].down = down;
+  keyq[keyqhead].ms = ms;
+  keyqhead = next;
+}
+
+static void keypoll(void) { // Scan every KEYSCANMS (at once after a row interrupt) and queue debounced changes
+  unsigned long now = millis();
+  boolean idle = keylast == NOPRINTNOKEY && keystable == NOPRINTNOKEY;
+  if (!(keysensed && idle) && now - keyscanms < KEYSCANMS) return;
+  keysensed = false;
+  keyscanms = now;
+  byte k = keyscan();
+  if (k == keylast && k != keystable) { // Same key in two scans - accept
+    if (keystable != NOPRINTNOKEY) keyqueue(keystable, false, now);
+    if (k != NOPRINTNOKEY) keyqueue(k, true, now);
+    if (k == KEY13) keyabort = true;
+    keystable = k;
+  }
+  keylast = k;
+}
+
+static boolean keypending(void) { // Key events waiting for getkey()
+  return keyqhead != keyqtail;
+}
+
+static byte getkey(void) { // Take next key event - returns the key held down after it
+  keypoll();
+  if (keypending()) {
+    keyevent& e = keyq[keyqtail];
+    keyqtail = (keyqtail + 1) & (KEYQUEUE - 1);
+    keylevel = e.down ? e.key : NOPRINTNOKEY;
+    if (e.down) keydownms = e.ms;
+    if (e.down && e.key == KEY13) keyabort = false; // Taken as normal key
+  }
+  return (keylevel);
+}
+
+static boolean abortRequested(void) { // True once after C was pressed - the press is swallowed
+  keypoll();
+  if (!keyabort) return false;
+  keyabort = false;
+  for (byte i = keyqtail; i != keyqhead; i = (i + 1) & (KEYQUEUE - 1))
+    if (keyq[i].key == KEY13) keyq[i].down = false;
+  return true;
+}
+
 // ***** S Y S T E M
 
 // DEFINES
-#define FRAMERATE 5 // was 9  // Maximum number of screen refreshes per second (MUST BE >3) 
+#define FRAMERATE 25 // was 5 // Maximum number of screen refreshes per second (MUST BE >3)
+#define TICKMS 100 // Time in ms between clock and power management ticks
+#define EVKEY     0x01 // Event sources of nextevent()
+#define EVTICK    0x02
+#define EVCOMPUTE 0x04
+#define EVREDRAW  0x08
 #define SIZES 0x01 // Printing size
 #define SIZEM 0x02 // Printing size
 #define SIZEL 0x04 // Printing size
@@ -953,22 +1071,6 @@ static void idle(void) {
     __WFE(); // Wait For Event (ARM intrinsic)
 }
 
-static bool nextFrame(void) { // Wait (idle) for next frame
-  byte now = (byte) millis(), framedurationms = now - thisframestart;
-  if (justrendered) {
-    lastframedurationms = framedurationms;
-    justrendered = false;
-    return false;
-  }
-  else if (framedurationms < eachframemillis) {
-    if (++framedurationms < eachframemillis) idle();
-    return false;
-  }
-  justrendered = true;
-  thisframestart = now;
-  return true;
-}
-
 static byte expand4bit(byte b) { // 0000abcd  Expand 4 bits (lower nibble)
   b = (b | (b << 2)) & 0x33;     // 00ab00cd
   b = (b | (b << 1)) & 0x55;     // 0a0b0c0d
@@ -1007,7 +1109,6 @@ static void printcat(byte c, byte fnt, boolean bitshift, byte w, byte h, byte x,
       for (byte j = 0; j < w; j++) dbuf[x + (w * i + j) + (y + k) * SCREENWIDTH] = tmp;
     }
   }
-  flush_dbuf_to_oled();
 }
 
 static void printsat(char * s, boolean bitshift, byte w, byte h, byte x, byte y) {
@@ -1016,7 +1117,6 @@ static void printsat(char * s, boolean bitshift, byte w, byte h, byte x, byte y)
       printcat(s[i], FONT4, bitshift, w, h, x + i * (FONTWIDTH + 1) * w , y );
       i++;
   }
-  flush_dbuf_to_oled();
 }
 
 static void printpixel(int x, int y) { // Print graph pixel at x,y
@@ -1095,6 +1195,7 @@ static void sleepnow(void) {
 #define TINYNUMBER   1e-12 // Number for rounding to 0, was 1e-8
 #define ALMOSTZERO   1e-37 // Limits to decide if sci or fix
 #define OVERFLOW        99 // Max power of 10 before overflow, was 36
+#define OVERFLOWMAX   1e99 // 10^OVERFLOW as a real limit for the fast paths
 #define OVERFLOWEXP    227 // Max power of e before overflow, was 87
 #define FIXMIN        1e-3 // Limits for fix display guarantee maximum
 #define FIXMAX         1e7 //             number of significant digits
@@ -1103,6 +1204,8 @@ static void sleepnow(void) {
 #define ISF              1 // F-key demanded
 #define ISG              2 // G-key demanded
 #define FLONGPRESSTIME 350 // Time in ms when f longpress starts
+#define RUNSLICEMS      20 // Time slice in ms for running programs before keys and screen are polled
+#define RUNBATCH       256 // Program steps between time slice checks
 #define MAXSTRBUF       23 // Maximum length of string buffer sbuf[]
 #define ALPHABUFSIZE    13 // maximum size of alpha
 #define PRGNAMEMAX       3 // maximum number of characters of program name
@@ -1138,9 +1241,16 @@ static_assert((EEMEM % alignof(double)) == 0, "EEMEM must be double-aligned");
 static_assert((EEMEMB % alignof(int64_t)) == 0, "EEMEMB must be 8-byte aligned");
 static_assert(EEMENU + MENUITEMS <= WL_BRIGHTNESS_START, "Menu slots overlap wear-level region"); //224b with MEMNR=10, 1672b with MEMNR=100
 static_assert(EEUSTART > EEMENU + MENUITEMS, "User area must start after menu/config region");
-#define EEUEND   EEPROM.length()
+#define EEJOURNALSIZE 2048 // Register journal at the end of the page (STO, business and menu records)
+#define EEJOURNAL (EEPROM.length() - EEJOURNALSIZE)
+static boolean jlegacy; // Programs saved before the journal reach into its space - journal stays off
+#define EEUEND   (jlegacy ? EEPROM.length() : EEJOURNAL)
 #define EEU (EEUEND-EEUSTART) // Available user memory
 
+static void readconst(byte slot, double& r, double& i);
+static int64_t readbusiness(void);
+static byte readmenu(byte slot);
+
 #if LOG_FLASH_STORCL
 struct ConstantSlotBits {
   ConstantSlotBits() : raw(0) {}
@@ -1166,8 +1276,7 @@ static void logConstantSlotSnapshot(byte slot, const char* phase) {
   if (slot != 3 && slot != 5) return;
   ConstantSlotBits realBits;
   ConstantSlotBits imagBits;
-  EEPROM.get(EEMEM + slot * sizeof(double), realBits);
-  EEPROM.get(EEMEM + (slot + MEMNR) * sizeof(double), imagBits);
+  readconst(slot, realBits.value, imagBits.value);
   char realRaw[17];
   char imagRaw[17];
   formatHex64(realBits.raw, realRaw, sizeof(realRaw));
@@ -1201,9 +1310,21 @@ static bool commitBusinessSlot(int64_t businessValue);
 static bool commitMenuSlot(byte slot, byte cmdId);
 static void warnIfConstantSlotOutOfRange(byte slot, const char* region, uint32_t startAddr);
 
-#define DATASTACKSIZE 26 // DATA STACK
-struct data ds[DATASTACKSIZE];
-static byte dp = 0;
+#ifndef DATASTACKSIZE
+#define DATASTACKSIZE 26 // DATA STACK depth, 26 to 256 levels
+#endif
+#if DATASTACKSIZE < 26 || DATASTACKSIZE > 256
+#error DATASTACKSIZE must be 26 to 256
+#endif
+static struct datastack { // Ring buffer - ds[0] is the bottom level, ds[dp - 1] the top
+  struct data buf[DATASTACKSIZE];
+  int base; // Index of bottom level in buf[]
+  struct data& operator[](int i) {
+    i += base;
+    return buf[i < DATASTACKSIZE ? i : i - DATASTACKSIZE];
+  }
+} ds;
+static int dp = 0;
 
 // RAM Storage - 100 memory slots for fast access in an array using ~2.4kB of RAM
 #define RAMMEMNR 100 // Number of RAM memory slots
@@ -1229,7 +1350,6 @@ static boolean isfloated = false; // True, if data stack was floated
 boolean isgetkey = false; // Needed for getkey function
 static char alpha[ALPHABUFSIZE] = {'\0'}; // String buffer (alpha) for user text output // was NULL
 static boolean isprintalpha = false; // Print alpha if true
-static long timestamp; // Timestamp for f longpress
 static boolean freleased = false; // Used for releasing longpressed f-key
 static byte darktime; // Time of inactivity for dark screen (in 10 x s)
 static long durationtimestamp = millis();
@@ -1256,6 +1376,8 @@ static boolean isprgdict = false, isprgmenu = false, isprgnew = false;
 static boolean isprgeditfirst = false;
 static int sou; // Size of user programs
 static byte nou; // Number of user programs
+static int usrptr[MAXCMDU - MAXCMDB + 1]; // Flash address of each user program name, usrptr[nou] = list terminator
+static byte usrindexed; // Number of valid usrptr[] entries (0 = rescan flash)
 static byte prgbuf[PRGSIZEMAX], oldprgbuflen; // Program buffer for fast editing
 static int prgaddr; // EEPROM address of actual program
 static byte prgbuflen; // Size of program in program buffer
@@ -1326,6 +1448,7 @@ static constexpr double GK_DEFAULT_REL_TOL = 1e-7;
 static constexpr double GK_MIN_INTERVAL = 1e-12;
 static constexpr uint8_t GK_MAX_DEPTH = 12; // was 16, increase if more accuracy needed
 static constexpr byte GK_STACK_LIMIT = 48;
+static constexpr uint16_t GK_POLL_INTERVAL_MS = 250; // C-key check and progress redraw while integrating
 
 struct AdaptiveGKInterval {
   double a;
@@ -1427,10 +1550,114 @@ static double gkCurrentNodePosition() {
   return gkController.center + gkController.halfwidth * gk_nodes[gkController.nodeIndex];
 }
 
+enum class GKStep {
+  NextNode, // More nodes to evaluate, next x at gkCurrentNodePosition()
+  Complete, // Interval stack drained, gkController.total holds the result
+  Overflow  // Interval stack exhausted while refining
+};
+
+// Feed f(x) of the current node into the controller; refines or advances to the next interval
+static GKStep gkAccumulateSample(double fx, double& localError) {
+  gkEvalCount++;
+  uint8_t node = gkController.nodeIndex;
+  gkController.kronrodSum += gk_weights[node] * fx;
+  if (gk_gauss_weights[node] != 0.0) gkController.gaussSum += gk_gauss_weights[node] * fx;
+  gkController.nodeIndex++;
+  if (gkController.nodeIndex < GK_POINTS) return GKStep::NextNode;
+
+  double kronrodEstimate = gkController.kronrodSum * gkController.halfwidth;
+  double gaussEstimate = gkController.gaussSum * gkController.halfwidth;
+  localError = _abs(kronrodEstimate - gaussEstimate);
+  gkController.lastError = max(gkController.lastError, localError);
+  gkRecordIntervalStats();
+  double adaptiveTol = max(gkController.current.tol, gkController.targetRelTol * _abs(kronrodEstimate));
+  bool accept = (localError <= adaptiveTol) ||
+                (gkController.current.depth >= GK_MAX_DEPTH) ||
+                (gkController.halfwidth <= GK_MIN_INTERVAL);
+
+  gkLogProgress("estimate", localError, adaptiveTol, accept);
+  if (accept) {
+    gkController.total += kronrodEstimate;
+  }
+  else {
+    double mid = 0.5 * (gkController.current.a + gkController.current.b);
+    double childTol = gkController.current.tol * 0.5;
+    gkRefinementCount++;
+    bool pushOk = gkPushInterval(mid, gkController.current.b, childTol, gkController.current.depth + 1) &&
+                  gkPushInterval(gkController.current.a, mid, childTol, gkController.current.depth + 1);
+    if (!pushOk) {
+      gkLogProgress("overflow", localError, adaptiveTol, false);
+      return GKStep::Overflow;
+    }
+  }
+  return gkStartNextInterval() ? GKStep::NextNode : GKStep::Complete;
+}
+
 static double plot[GRAPH_PIXEL_WIDTH]; // Y-values of plot graph
 static double plota, plotb, plotd, ymax, ymin; // Variables used for plotting
 static boolean isplot = false, isplotcalc = false; // True if plotting or plot calculation is demanded
-static boolean isplotEvalInFlight = false; // True while a user program evaluation is running
+static constexpr uint16_t PLOT_POLL_INTERVAL_MS = 100; // C-key check (and progressive redraw) while sampling
+
+static void drawplot(byte n) { // Draw the first n samples of plot[] scaled to their own y range
+  if (!n) return;
+  double ymax = plot[0], ymin = plot[0];
+  for (byte i = 0; i < n; i++) { // Find ymax and ymin
+    ymax = max(ymax, plot[i]); ymin = min(ymin, plot[i]);
+  }
+
+  double yspan = ymax - ymin;
+  bool isFlatLine = fabs(yspan) < 1e-12;
+  double yscaleForLog = isFlatLine ? 0.0 : yspan / (GRAPH_PIXEL_HEIGHT - 1);
+  auto mapSampleToPixel = [&](double sample) -> int {
+    if (isFlatLine) return GRAPH_PIXEL_HEIGHT / 2;
+    double relative = (sample - ymin) / (yspan == 0.0 ? 1.0 : yspan);
+    if (relative < 0.0) relative = 0.0;
+    else if (relative > 1.0) relative = 1.0;
+    return (int)lround((GRAPH_PIXEL_HEIGHT - 1) * (1.0 - relative));
+  };
+#if LOG_PLOT
+  Serial.print("[PLOT] render ymin="); Serial.print(ymin, 10);
+  Serial.print(" ymax="); Serial.print(ymax, 10);
+  Serial.print(" yscale="); Serial.print(yscaleForLog, 10);
+  Serial.print(" firstSample="); Serial.print(plot[0], 10);
+  Serial.print(" lastSample="); Serial.println(plot[n - 1], 10);
+#endif
+  if (plota * plotb <= 0) printvline(-plota * (GRAPH_PIXEL_WIDTH / (plotb - plota))); // Y-axis
+  if (ymin * ymax <= 0) printhline(mapSampleToPixel(0.0)); // X-axis
+
+  // Draw smooth lines between consecutive points instead of just plotting pixels
+  int prevX = -1, prevY = -1;
+  for (byte i = 0; i < n; i++) {
+    int currX = i;
+    double relative = isFlatLine ? 0.5 : (plot[i] - ymin) / (yspan == 0.0 ? 1.0 : yspan);
+    double unclampedRelative = relative;
+    if (relative < 0.0) relative = 0.0;
+    else if (relative > 1.0) relative = 1.0;
+    int currY = (int)lround((GRAPH_PIXEL_HEIGHT - 1) * (1.0 - relative));
+
+#if LOG_PLOT
+    if (!isFlatLine && (unclampedRelative < 0.0 || unclampedRelative > 1.0)) {
+      Serial.print("[PLOT] clipped sample idx="); Serial.print(i);
+      Serial.print(" x="); Serial.print(currX);
+      Serial.print(" unclampedNorm="); Serial.print(unclampedRelative, 10);
+      Serial.print(" ymin="); Serial.print(ymin, 10);
+      Serial.print(" ymax="); Serial.print(ymax, 10);
+      Serial.print(" sample="); Serial.println(plot[i], 10);
+    }
+#endif
+
+    if (prevX == -1) {
+      // First point - just plot it
+      printpixel(currX, currY);
+    } else {
+      // Draw line from previous point to current point
+      drawLine(prevX, prevY, currX, currY);
+    }
+
+    prevX = currX;
+    prevY = currY;
+  }
+}
 
 static byte msgnr = 0; // MESSAGES
 #define MSGASK      0
@@ -1475,10 +1702,13 @@ const char* const msg[] PROGMEM = {
 #define _MULT 22
 #define _DIV 25
 #define _ADD 27
+#define _CLR 28
 #define _SWAP 30
 #define _STO 33
 #define _STO_RAM 120  // New command for RAM store (uses dispatch array index 120)
 #define _RCL_RAM 121  // New command for RAM recall (uses dispatch array index 121)
+#define _FINT 34
+#define _FPLOT 37
 #define _BASE 40
 #define _PICK 45
 #define _ROT 46
@@ -1549,7 +1779,7 @@ const char* const msg[] PROGMEM = {
 static constexpr uint8_t kEndMarkerByte = static_cast<uint8_t>(_END);
 
 // Builtin functions (mem)
-const byte mem[] PROGMEM = {
+constexpr byte mem[] PROGMEM = {
   _END, // Necessary to prevent function starting with mp = 0
   _1, _0, _BASE, _END, //0 BUSINESS
   _1, _6, _BASE, _END, //1 HEX
@@ -1689,6 +1919,36 @@ const byte mem[] PROGMEM = {
 
 };
 
+// Offsets of builtin functions in mem[], computed at compile time (binary recursion keeps constexpr depth low)
+static constexpr int memends(int lo, int hi) { // Number of _END in mem[lo..hi)
+  return hi - lo <= 0 ? 0 : hi - lo == 1 ? (mem[lo] == _END) : memends(lo, (lo + hi) / 2) + memends((lo + hi) / 2, hi);
+}
+static constexpr int memseek(int k, int lo, int hi) { // Smallest offset in [lo..hi] behind the (k+1)-th _END
+  return lo >= hi ? lo : memends(0, (lo + hi) / 2) > k ? memseek(k, lo, (lo + hi) / 2) : memseek(k, (lo + hi) / 2 + 1, hi);
+}
+#define MEMOFS(k) memseek(k, 0, sizeof(mem))
+#define MEMOFS4(k) MEMOFS(k), MEMOFS(k + 1), MEMOFS(k + 2), MEMOFS(k + 3)
+static constexpr uint16_t memofs[] = { // Run-address of builtin _BUS + i
+  MEMOFS4(0), MEMOFS4(4), MEMOFS4(8), MEMOFS4(12), MEMOFS4(16), MEMOFS4(20),
+  MEMOFS4(24), MEMOFS4(28), MEMOFS4(32), MEMOFS4(36), MEMOFS4(40)
+};
+#undef MEMOFS4
+#undef MEMOFS
+static_assert(sizeof(memofs) / sizeof(memofs[0]) == _LGAL - _BUS + 1, "memofs[] must cover _BUS.._LGAL");
+static_assert(memends(0, sizeof(mem)) == _LGAL - _BUS + 2, "mem[] must hold exactly one function per _BUS.._LGAL (plus leading _END)");
+static_assert(mem[sizeof(mem) - 1] == _END, "mem[] must end with _END");
+static_assert(memofs[0] == 1 && mem[memofs[_COS - _BUS] - 1] == _END && memends(0, memofs[_COS - _BUS]) == _COS - _BUS + 1,
+              "memofs[] out of step with mem[]"); // COS starts behind its own _END
+static_assert(_LGAL + 1 == _STO_RAM && _RCL_RAM + 1 == MAXCMDB, "builtin numbering must end at MAXCMDB");
+
+static const byte* usrcode = nullptr; // Direct flash view of the user area, dropped when the page rotates
+
+static inline byte fetchcode(int addr) { // Program byte at run-address addr (builtin or user)
+  if (addr < (int)sizeof(mem)) return mem[addr];
+  if (!usrcode) usrcode = EEPROM.dataPointer(EEUSTART);
+  return usrcode[addr - sizeof(mem)];
+}
+
 // Command names
 const char c0[] PROGMEM = "0"; //      PRIMARY KEYS
 const char c1[] PROGMEM = "1";
@@ -1826,7 +2086,11 @@ const char* const cmd[] PROGMEM = {
   c117, c118, c119, c120, c121
 };
 
+static byte cmdorder[MAXCMDB]; // Builtin commands in strcmp order of cmd[] - built by the first sort()
+static boolean cmdordered = false; // cmdorder[] is built
 static byte cmdsort[MAXCMDU]; // Alphabetically sorted commands for DICT
+static char usrname[MAXCMDU - MAXCMDB][PRGNAMEMAX]; // Names of indexed user programs
+static boolean dictstale = true; // cmdsort[] needs a rebuild from cmdorder[] and usrname[]
 
 #if LOG_USER_MENU
 static void logUserMenuCommand(const char* phase, byte cmdId) {
@@ -1898,9 +2162,16 @@ static boolean isreal(void);
 static double absolute(double, double);  
 static double angle(double, double);  
 static double texp(double);  
+static struct data zmul(struct data, struct data), zdiv(struct data, struct data), zinv(struct data);
+static struct data zln(struct data), zexp(struct data), zsqrt(struct data), zasin(struct data);
+static void dpushz(struct data);
+static boolean bothzero(double, double), isoverflow(double);
 static void execute(byte);  
 static void limitdarktime(void);  
 static void eepromMove(int from, int to, int length);  
+static void printmsg(byte);
+static void printint(int, boolean, byte, byte);
+static boolean printscreen(void);
 
 // FUNCTION POINTER ARRAY
 static void (*dispatch[])(void) = { // Function pointer array
@@ -1977,14 +2248,30 @@ static void seekmem(byte n);
 static void _absolute(void) { // ABS
   seekmem(_ABS);
 }
-static void _acos(void) { // ACOS
-  seekmem(_ACOS);
+static void _acos(void) { // ACOS acos(z)=PI/2-asin(z), real in degrees (real part beyond +-1)
+  struct data a = dpop();
+  if (a.i == 0.0) dpushr(_abs(a.r) <= 1.0 ? acos(a.r) * RAD : (a.r > 0.0 ? 0.0 : 180.0));
+  else {
+    struct data s = zasin(a);
+    dpushz({PI / 2 - s.r, -s.i, 0LL});
+  }
 }
-static void _acosh(void) { // ACOSH
-  seekmem(_ACOSH);
+static void _acosh(void) { // ACOSH acosh(z)=ln(z+sqrt(z+1)*sqrt(z-1))
+  struct data a = dpop();
+  if (a.i == 0.0 && a.r >= 1.0) dpushr(acosh(a.r));
+  else {
+    struct data s = zmul(zsqrt({a.r + 1.0, a.i, 0LL}), zsqrt({a.r - 1.0, a.i, 0LL}));
+    dpushz(zln({a.r + s.r, a.i + s.i, 0LL}));
+  }
 }
 static void _add(void) { // ADD + (a+i*b)(c+i*d)=(a+c)+i*(b+d)
   struct data b = dpop(), a = dpop();
+  if (a.i == 0.0 && b.i == 0.0) { // Real
+    double re = a.r + b.r;
+    if (_abs(re) >= 10.0 * OVERFLOWMAX) msgnr = MSGOVERFLOW; // (int16_t)log10() > OVERFLOW
+    else dpush({re, 0.0, a.b + b.b});
+    return;
+  }
   double re = a.r + b.r, im = a.i + b.i;
 #if LOG_OVERFLOW
   double re_log = log10(_abs(re));
@@ -2026,17 +2313,38 @@ static void _alphaput(void) { // ALPHA PUTCHAR
   }
   isprintalpha = true;
 }
-static void _asin(void) { // ASIN
-  seekmem(_ASIN);
+static void _asin(void) { // ASIN asin(z)=-i*ln(i*z+sqrt(1-z*z)), real in degrees (real part beyond +-1)
+  struct data a = dpop();
+  if (a.i == 0.0) dpushr(_abs(a.r) <= 1.0 ? asin(a.r) * RAD : (a.r > 0.0 ? 90.0 : -90.0));
+  else dpushz(zasin(a));
 }
-static void _asinh(void) { // ASINH
-  seekmem(_ASINH);
+static void _asinh(void) { // ASINH asinh(z)=ln(z+sqrt(z*z+1))
+  struct data a = dpop();
+  if (a.i == 0.0) dpushr(asinh(a.r));
+  else {
+    struct data s = zsqrt({a.r * a.r - a.i * a.i + 1.0, 2.0 * a.r * a.i, 0LL});
+    dpushz(zln({a.r + s.r, a.i + s.i, 0LL}));
+  }
 }
-static void _atan(void) { // ATAN
-  seekmem(_ATAN);
+static void _atan(void) { // ATAN atan(z)=i/2*ln((1-i*z)/(1+i*z)), real in degrees
+  struct data a = dpop();
+  if (a.i == 0.0) dpushr(atan(a.r) * RAD);
+  else if (a.r == 0.0 && _abs(a.i) == 1.0) msgnr = MSGOVERFLOW; // Pole at +-i
+  else {
+    struct data l = zln(zdiv({1.0 + a.i, -a.r, 0LL}, {1.0 - a.i, a.r, 0LL}));
+    if (a.r == 0.0 && a.i > 1.0) l.i = -l.i; // Cut: quotient is negative real, keep +90 for +i
+    dpushz({-l.i / 2.0, l.r / 2.0, 0LL});
+  }
 }
-static void _atanh(void) { // ATANH
-  seekmem(_ATANH);
+static void _atanh(void) { // ATANH atanh(z)=ln((1+z)/(1-z))/2
+  struct data a = dpop();
+  if (a.i == 0.0 && _abs(a.r) == 1.0) msgnr = MSGOVERFLOW;
+  else if (a.i == 0.0 && _abs(a.r) < 1.0) dpushr(atanh(a.r));
+  else if (a.i == 0.0) dpush({log(_abs((1.0 + a.r) / (1.0 - a.r))) / 2.0, PI / 2, 0LL}); // Real beyond +-1
+  else {
+    struct data l = zln(zdiv({1.0 + a.r, a.i, 0LL}, {1.0 - a.r, -a.i, 0LL}));
+    dpushz({l.r / 2.0, l.i / 2.0, 0LL});
+  }
 }
 static void _base(void) { // BASE MODE
   if (base) { // Return from base mode
@@ -2114,8 +2422,7 @@ static struct {
   uint8_t minutes;
   uint8_t seconds;
   unsigned long previousMillis;
-  unsigned long lastKeyCheck;
-} clockState = {false, 0, 0, 0, 0, 0};
+} clockState = {false, 0, 0, 0, 0};
 
 static void _clock(void) { // CLOCK
   if (dp > 0) { // Start clock if there's something on the stack
@@ -2152,7 +2459,6 @@ static void _clock(void) { // CLOCK
     // Initialize clock state
     clockState.active = true;
     clockState.previousMillis = millis();
-    clockState.lastKeyCheck = millis();
     
     // Clear stack and show initial time
     dp = 0;
@@ -2176,22 +2482,6 @@ static void clockUpdate() { // Called from main loop when clock is active
   // Update powertimestamp to prevent device from sleeping during clock operation
   powertimestamp = currentMillis;
   
-  // Check for key press to exit
-  if (currentMillis - clockState.lastKeyCheck >= 100) {
-    clockState.lastKeyCheck = currentMillis;
-    key = getkey();
-    if (key < NOPRINTNOKEY && key != oldkey) {
-      oldkey = key;
-#if LOG_CLOCK
-      Serial.println("[CLK] Key pressed, stopping clock");
-#endif
-      clockState.active = false;
-      powertimestamp = millis(); // Reset power management timer
-      isprintscreen = true;
-      return;
-    }
-  }
-  
   // Update time every second with drift compensation
   unsigned long elapsed = currentMillis - clockState.previousMillis;
   if (elapsed >= 1000) {
@@ -2328,8 +2618,7 @@ static void _condseek(void) { // CONDITION - seek next ELSE or THEN
   byte cltmp = 0; // Local conditional level
   while (isloop) {
     byte c = '\0'; 
-    if (mp < sizeof(mem))  c = mem[mp++]; // Builtin 
-    else if (mp < sizeof(mem) + sou) EEPROM.get(mp++ -sizeof(mem) + EEUSTART, c); // User
+    if (mp < sizeof(mem) + sou) c = fetchcode(mp++); // Builtin or user
 
     if (mp >= sizeof(mem) + sou) { // No corresponding ELSE or THEN
       msgnr = MSGNEST;
@@ -2365,11 +2654,27 @@ static void _cvkm2mi(void) { // CONVERT KM>MI
 static void _cvm2ft(void) { // CONVERT M>FT
   seekmem(_MFT);
 }
-static void _cos(void) { // COS
-  seekmem(_COS);
+static double degsin(double deg, double* c) { // Sine and cosine in degrees - exact 0 and 1 at multiples of 90
+  deg = fmod(deg, 360.0); // fmod is exact
+  double q = round(deg / 90.0), r = (deg - 90.0 * q) / RAD, s = sin(r), k = cos(r);
+  switch ((int)q & 3) { // Rotate by quadrant - 0.0 - x keeps zeros positive
+    case 1: *c = 0.0 - s; return k;
+    case 2: *c = 0.0 - k; return 0.0 - s;
+    case 3: *c = s; return 0.0 - k;
+  }
+  *c = k; return s;
+}
+static void _cos(void) { // COS cos(a+i*b)=cos(a)*cosh(b)-i*sin(a)*sinh(b), real in degrees
+  struct data a = dpop();
+  double c;
+  if (a.i == 0.0) { degsin(a.r, &c); dpushr(c); }
+  else dpushz({cos(a.r) * cosh(a.i), -sin(a.r) * sinh(a.i), 0LL});
 }
-static void _cosh(void) { // COSH
-  seekmem(_COSH);
+static void _cosh(void) { // COSH cosh(a+i*b)=cosh(a)*cos(b)+i*sinh(a)*sin(b)
+  struct data a = dpop();
+  if (a.r > OVERFLOWEXP || a.r < -OVERFLOWEXP) msgnr = MSGOVERFLOW;
+  else if (a.i == 0.0) dpushr(cosh(a.r));
+  else dpushz({cosh(a.r) * cos(a.i), sinh(a.r) * sin(a.i), 0LL});
 }
 static void _dict(void) { // DICT
   if (!base) {
@@ -2377,7 +2682,7 @@ static void _dict(void) { // DICT
     isdict = true;
   }
 }
-static void _div(void) { // DIV / a/b=a*inv(b)
+static void _div(void) { // DIV / a/b
   if (base) {
     int64_t divisor = dpopb();
     if (!divisor) {
@@ -2416,11 +2721,21 @@ static void _div(void) { // DIV / a/b=a*inv(b)
 
     dpushb(scaled);
   }
-  else {
-    _inv();
-    if (dp < 2) return;
-    _mul();
+  else if (dp >= 2) {
+    struct data b = dpop();
+    if (bothzero(b.r, b.i)) msgnr = MSGOVERFLOW; // Dividend stays
+    else if (ds[dp - 1].i == 0.0 && b.i == 0.0) { // Real
+      double q = dpoprd() / b.r;
+      if (!(_abs(q) <= OVERFLOWMAX)) msgnr = MSGOVERFLOW;
+      else dpushr(q);
+    }
+    else {
+      struct data q = zdiv(dpop(), b);
+      if (isoverflow(q.r) || isoverflow(q.i)) msgnr = MSGOVERFLOW;
+      else dpush(q);
+    }
   }
+  else _inv(); // Single operand: 1/b
 }
 static void _dot(void) { // DOT .
   bool was_isnewnumber = isnewnumber;
@@ -2474,6 +2789,7 @@ static void _exe(void) { // EXE
 static void _exp(void) { // EXP exp(a+jb)=exp(a)*(cos(b)+i*sin(b))
   struct data a = dpop();
   if (a.r > OVERFLOWEXP) msgnr = MSGOVERFLOW;
+  else if (a.i == 0.0) dpush({texp(a.r), 0.0, a.b}); // Real
   else {
     double tmp = texp(a.r);
     double realPart = tmp * cos(a.i);
@@ -2542,20 +2858,204 @@ static void _fnfx(void) { // FN F(X)
   }
 }
 
+// Pre-decoded program cells - one per run-address, so mp keeps its meaning for BEGIN, IF, EXE and BREAK
+#define TCODEUSR 2048 // Maximum user area bytes held as cells, the rest runs through the byte interpreter
+#define TNEWNUM 0x01 // Step ends number entry (command > 10 except CE)
+#define TSELF   0x02 // Handler does its own bookkeeping
+#define TLITMIN 2 // Shortest digit run folded into one literal step
+#define TJUMPNEST 16 // IF/ELSE levels resolved by tbuild(), deeper ones seek at run time
+#define TGROW 256 // Cells and literals are allocated in steps of TGROW and never shrink
+
+struct tcell { // Pre-decoded program step
+  void (*fn)(void); // Handler, nullptr = run through the byte interpreter
+  uint16_t arg;     // Call target
+  byte len;         // Bytes covered by this step
+  byte flags;
+};
+
+struct tliteral { // Number entered by a folded run of digit/dot steps
+  double r;
+  int64_t b;
+  byte decimals;
+  boolean isdot;
+};
+
+static tcell* tcode = nullptr; // Cells for run-addresses 0 ... tcells-1
+static int tcells = 0;
+static tliteral* tlits = nullptr; // Literal operands, indexed by tcell.arg
+static int tcodemax = 0, tlitsmax = 0; // Allocated cells and literals - kept across decodes, so saves do not fragment the heap
+static boolean tstale = true; // Decode again before the next step
+static const tcell* tcur; // Cell being executed
+static int twait[TJUMPNEST]; // IF and ELSE cells waiting for their target while tbuild() runs
+
+static void tend(void) { // _END - return from subroutine or end of run
+  if (ap) mp = apop();
+  else {
+    mp = 0;
+    isprintscreen = true; // Finally print screen
+  }
+}
+static void tcall(void) { // Call user program
+  apush(mp);
+  mp = tcur->arg;
+}
+
+static void tif(void) { // IF with the ELSE/THEN target resolved by tbuild()
+  cl++; // Increment conditional level
+  if (!dpopr()) mp = tcur->arg; // FALSE-Clause - jump behind ELSE or THEN
+}
+static void telse(void) { // ELSE with the THEN target resolved by tbuild()
+  if (!cl) msgnr = MSGNEST; // ELSE without corresponding IF
+  else {
+    mp = tcur->arg;
+    cl--;
+  }
+}
+
+static void tlit(void) { // Push folded number literal
+  const tcell* t = tcur;
+  if (base || !isnewnumber || isdot || decimals || isAF) { // Not a fresh decimal number - enter digits one by one
+    for (int a = mp - t->len; a < mp; a++) execute(fetchcode(a));
+    return;
+  }
+  const tliteral& l = tlits[t->arg];
+  dpush({l.r, 0.0, l.b});
+  isnewnumber = isAF = false;
+  isdot = l.isdot; decimals = l.decimals;
+  for (byte i = 0; i < t->len; i++) { // Hold demanded f-key status as execute() would per digit
+    if (fgm && setfgm) fgm = setfgm = 0;
+    setfgm = 1;
+  }
+}
+
+static byte tfold(int a, tliteral& l) { // Fold digit/dot run at a like _numinput() and _dot() would - returns length
+  int n = a;
+  boolean started = false;
+  l.r = 0.0; l.b = 0; l.decimals = 0; l.isdot = false;
+  for (byte c; n < tcells && n - a < 255 && (c = fetchcode(n)) <= _DOT; n++) {
+    if (c == _DOT) {
+      started = l.isdot = true;
+      l.b = 0;
+    }
+    else if (l.isdot) { // dpushr(dpopr() + k / pow10(++decimals)) - dpopr() is float
+      float f = l.r;
+      l.r = f + c / pow10(++l.decimals);
+      l.b = 0;
+    }
+    else if (!started) { // New numeral
+      l.r = c; l.b = c * 100LL;
+      started = true;
+    }
+    else { // dpushr(dpopr() * 10 + k)
+      float f = l.r;
+      l.r = f * 10 + c;
+      l.b = 0;
+    }
+  }
+  return (n - a);
+}
+
+static void tjump(int w, int a) { // Resolve IF or ELSE at w to jump behind a, as _condseek() would find it
+  if (w >= TJUMPNEST || a + 1 >= (int)sizeof(mem) + sou) return; // Not tracked or no target - seek at run time
+  tcell& t = tcode[twait[w]];
+  t.fn = fetchcode(twait[w]) == _IF ? &tif : &telse;
+  t.arg = a + 1;
+}
+static void tjumps(void) { // Resolve IF and ELSE targets in one pass over the cells
+  int nw = 0; // Cells waiting for their ELSE or THEN - only the first TJUMPNEST are tracked
+  for (int a = 0; a < tcells; a++) {
+    byte c = fetchcode(a);
+    if (c == _IF) {
+      if (nw < TJUMPNEST) twait[nw] = a;
+      nw++;
+    }
+    else if (c == _ELSE) { // Ends the waiting cell on top and waits itself
+      if (nw) tjump(nw - 1, a); else nw++;
+      if (nw <= TJUMPNEST) twait[nw - 1] = a;
+    }
+    else if (c == _THEN && nw) tjump(--nw, a);
+  }
+}
+
+static void* tgrow(void* p, int& have, int want, size_t size) { // Buffer for want items - reallocated only to grow
+  if (want <= have) return p;
+  free(p);
+  have = (want + TGROW - 1) / TGROW * TGROW;
+  p = malloc(have * size);
+  if (!p) have = 0;
+  return p;
+}
+
+static void tbuild(void) { // Decode builtin and user code into cells
+  tstale = false;
+  tcells = sizeof(mem) + min(sou, TCODEUSR);
+  int nlits = 0;
+  for (int a = 0; a < tcells; a++) // Count digit runs
+    if (fetchcode(a) <= _DOT && (!a || fetchcode(a - 1) > _DOT)) nlits++;
+  tcode = (tcell*)tgrow(tcode, tcodemax, tcells, sizeof(tcell));
+  tlits = (tliteral*)tgrow(tlits, tlitsmax, nlits, sizeof(tliteral));
+  if (!tcode || (nlits && !tlits)) { // Run through the byte interpreter
+    tcells = 0;
+    if (Serial) Serial.println(F("[TCODE] Out of memory - programs run undecoded"));
+    return;
+  }
+  nlits = 0;
+  for (int a = 0; a < tcells; a++) {
+    byte c = fetchcode(a);
+    tcell& t = tcode[a];
+    t.fn = nullptr; t.arg = 0; t.len = 1;
+    t.flags = (c > 10 && c != 12) ? TNEWNUM : 0;
+    if (c == _END) {
+      t.fn = &tend; t.flags = TSELF;
+    }
+    else if (c <= _DOT && (!a || fetchcode(a - 1) > _DOT)) { // Start of a number
+      byte len = tfold(a, tlits[nlits]);
+      if (len >= TLITMIN) {
+        t.fn = &tlit; t.arg = nlits++; t.len = len; t.flags = TSELF;
+      }
+      else t.fn = dispatch[c];
+    }
+    else if (c < MAXCMDB) t.fn = dispatch[c];
+    else if (c < MAXCMDU && c - MAXCMDB < usrindexed) {
+      t.fn = &tcall;
+      t.arg = usrptr[c - MAXCMDB] + PRGNAMEMAX - EEUSTART + sizeof(mem);
+    }
+  }
+  tjumps();
+}
+
+static boolean tstep(void) { // Run one pre-decoded step at mp, false if mp has no cell
+  if (tstale) tbuild();
+  if (mp >= tcells || !tcode[mp].fn) return false;
+  const tcell* t = tcur = &tcode[mp];
+  byte flags = t->flags; // Handler may decode again (flash rewrite)
+  mp += t->len;
+  (*t->fn)();
+  if (flags & TSELF) return true;
+  if ((flags & TNEWNUM) && !isAF) { // Same bookkeeping as execute()
+    decimals = 0; isdot = false; isnewnumber = true;
+  }
+  if (fgm && setfgm) fgm = setfgm = 0; // Hold demanded f-key status one cycle
+  setfgm = 1;
+  return true;
+}
+
 static constexpr uint16_t FX_IMMEDIATE_STEP_LIMIT = 2048;
+static constexpr uint16_t FX_NO_STEP_LIMIT = 0xffff; // Run until _END, stop only when C is pressed
 
 static bool runImmediateProgram(uint16_t maxSteps) {
   if (!maxSteps) maxSteps = FX_IMMEDIATE_STEP_LIMIT;
   uint16_t steps = 0;
-  while (mp && steps++ < maxSteps) {
-    byte cmdByte = _END;
-    if (mp < sizeof(mem)) {
-      cmdByte = mem[mp++];
-    }
-    else if (mp < sizeof(mem) + sou) {
-      EEPROM.get(mp - sizeof(mem) + EEUSTART, cmdByte);
-      mp++;
+  while (mp) {
+    if (maxSteps == FX_NO_STEP_LIMIT) {
+      if (!(++steps % RUNBATCH) && abortRequested()) break; // Stop by pressing C
     }
+    else if (steps++ >= maxSteps) break;
+#if THREADED_CODE
+    if (tstep()) continue;
+#endif
+    byte cmdByte = _END;
+    if (mp < sizeof(mem) + sou) cmdByte = fetchcode(mp++); // Builtin or user
     else {
       mp = 0;
       return false;
@@ -2574,18 +3074,60 @@ static bool runImmediateProgram(uint16_t maxSteps) {
   return mp == 0;
 }
 
-static bool evaluateFxImmediate(double x, double& fx) {
-  if (base || mp) return false;
-  int saved_ap = ap;
+#if MATH_COMPARE
+static struct data mathrun(byte cmd, struct data x, struct data y, boolean native) { // One call, native or mem[]
+  dp = ap = 0; msgnr = 0;
+  dpush(y); dpush(x);
+  if (native) (*dispatch[cmd])();
+  else {
+    mp = 0; seekmem(cmd);
+    runImmediateProgram();
+  }
+  return msgnr ? (struct data){NAN, NAN, 0LL} : ds[dp - 1];
+}
+static void mathcompare(void) { // Print max deviation and time per call of native vs mem[] math builtins
+  static const struct { const char* name; byte cmd; } fn[] = {
+    {"SQRT", _SQRT}, {"POW", _POW}, {"LOG", _LOG}, {"PWR10", _PWR10}, {"COS", _COS}, {"TAN", _TAN},
+    {"ASIN", _ASIN}, {"ACOS", _ACOS}, {"ATAN", _ATAN}, {"SINH", _SINH}, {"COSH", _COSH}, {"TANH", _TANH},
+    {"ASINH", _ASINH}, {"ACOSH", _ACOSH}, {"ATANH", _ATANH},
+  };
+  static const struct data arg[] = {
+    {0.3, 0, 0}, {0.7, 0, 0}, {2.5, 0, 0}, {-0.4, 0, 0}, {30, 0, 0}, {90, 0, 0}, {0.5, 0.5, 0}, {-1.2, 0.8, 0}, {2, -3, 0},
+  };
+  const byte nargs = sizeof(arg) / sizeof(arg[0]);
+  for (byte f = 0; f < sizeof(fn) / sizeof(fn[0]); f++) {
+    double maxerr = 0.0;
+    unsigned long us[2];
+    for (byte a = 0; a < nargs; a++) { // Also warms up the decoded code cache before timing
+      struct data n = mathrun(fn[f].cmd, arg[a], {1.5, 0, 0}, true);
+      struct data m = mathrun(fn[f].cmd, arg[a], {1.5, 0, 0}, false);
+      double err = n.r != n.r && m.r != m.r ? 0.0 : absolute(n.r - m.r, n.i - m.i) / max(absolute(n.r, n.i), TINYNUMBER); // Both overflow - agree
+      if (err > maxerr || err != err) maxerr = err;
+    }
+    for (byte native = 0; native < 2; native++) {
+      unsigned long t = micros();
+      for (byte a = 0; a < nargs; a++) mathrun(fn[f].cmd, arg[a], {1.5, 0, 0}, native);
+      us[native] = micros() - t;
+    }
+    Serial.print("[MATH] "); Serial.print(fn[f].name);
+    Serial.print(" maxrel="); Serial.print(maxerr, 12);
+    Serial.print(" native_us="); Serial.print((double)us[1] / nargs, 2);
+    Serial.print(" mem_us="); Serial.println((double)us[0] / nargs, 2);
+  }
+  dp = ap = 0; msgnr = 0; mp = 0;
+}
+#endif
+
+static bool evaluateFxImmediate(double x, double& fx, uint16_t maxSteps) {
+  if (base || mp || ap >= ADDRSTACKSIZE) return false;
+  int saved_ap = ap, saved_dp = dp;
+  apush(0); // _END of f(x) returns to mp = 0 instead of into a calling program
   dpushr(x);
   execute(MAXCMDB);
-  if (!runImmediateProgram()) {
+  if (!runImmediateProgram(maxSteps) || !dp) {
     mp = 0;
     ap = saved_ap;
-    return false;
-  }
-  if (!dp) {
-    ap = saved_ap;
+    dp = saved_dp; // Drop what f(x) left behind
     return false;
   }
   fx = dpoprd();
@@ -2593,6 +3135,13 @@ static bool evaluateFxImmediate(double x, double& fx) {
   isnewnumber = true;
   return true;
 }
+
+static void gkprogress(void) { // Progress line while integrating: RUN and number of evaluations
+  clearGraphBuffer();
+  printmsg(MSGRUN);
+  printint(gkEvalCount, false, 0, 3);
+  flush_dbuf_to_oled();
+}
 static void _fnintegrate(void) { // FN INTEGRATE
   if (!base) {
     _swap();
@@ -2643,8 +3192,55 @@ static void _fnintegrate(void) { // FN INTEGRATE
       return;
     }
 
-    dpushr(gkCurrentNodePosition());
+    // Run the whole adaptive loop here instead of one node per frame in loop()
+    int savedmp = mp; // FINT may be called from a running program
+    mp = 0;
     isint = true;
+    gkprogress();
+    unsigned long lastpoll = millis();
+    double localError = 0.0;
+    GKStep step = GKStep::NextNode;
+    while (step == GKStep::NextNode) {
+      double fx;
+      if (!evaluateFxImmediate(gkCurrentNodePosition(), fx, FX_NO_STEP_LIMIT)) {
+        msgnr = MSGRUN;
+        break;
+      }
+#if LOG_FX_FI_STACK
+      if (Serial) {
+        Serial.print("[FI] eval#"); Serial.print(gkEvalCount + 1);
+        Serial.print(" node="); Serial.print((int)gkController.nodeIndex);
+        Serial.print(" x="); Serial.print(gkCurrentNodePosition(), 8);
+        Serial.print(" fx="); Serial.print(fx, 8);
+        Serial.print(" dp="); Serial.print(dp);
+        Serial.print(" ap="); Serial.println(ap);
+      }
+#endif
+      step = gkAccumulateSample(fx, localError);
+      if (millis() - lastpoll >= GK_POLL_INTERVAL_MS) {
+        lastpoll = millis();
+        if (abortRequested()) break; // Abort with C
+        gkprogress();
+      }
+    }
+
+    if (step == GKStep::Overflow) msgnr = MSGOVERFLOW;
+    else if (step == GKStep::Complete) {
+      double finalResult = gkController.orientation * gkController.total;
+      if (Serial) {
+        Serial.print("Adaptive GK complete. result="); Serial.print(finalResult);
+        Serial.print(" maxErr="); Serial.print(gkController.lastError);
+        Serial.print(" evals="); Serial.print(gkEvalCount);
+        Serial.print(" refinements="); Serial.println(gkRefinementCount);
+      }
+      dpushr(localError); // Push estimated error
+      dpushr(finalResult); // Push final result
+    }
+    mp = savedmp;
+    isnewnumber = true;
+    isint = false;
+    gkResetController();
+    isprintscreen = true;
   }
 }
 void _fnplot() { // FN PLOT
@@ -2656,10 +3252,7 @@ void _fnplot() { // FN PLOT
     else {
       plotd = 0.0;
     }
-    cycles = 0;
     for (byte i = 0; i < GRAPH_PIXEL_WIDTH; ++i) plot[i] = 0.0;
-    isplot = isplotcalc = true;
-    isplotEvalInFlight = false;
 #if LOG_PLOT
     Serial.print("[PLOT] start interval [");
     Serial.print(plota, 10);
@@ -2670,6 +3263,41 @@ void _fnplot() { // FN PLOT
     Serial.print(" width=");
     Serial.println(GRAPH_PIXEL_WIDTH);
 #endif
+
+    // Sample all columns in one run, then render once via printscreen
+    int savedmp = mp; // FPLOT may be called from a running program
+    mp = 0;
+    isplot = false; isplotcalc = true;
+    isprintscreen = printscreen(); // Show "run" while sampling
+    unsigned long lastpoll = millis();
+    byte n = 0;
+    while (n < GRAPH_PIXEL_WIDTH) {
+      if (!evaluateFxImmediate(plota + n * plotd, plot[n], FX_NO_STEP_LIMIT)) {
+        msgnr = MSGRUN;
+        break;
+      }
+#if LOG_PLOT
+      Serial.print("[PLOT] y["); Serial.print(n);
+      Serial.print("]="); Serial.println(plot[n], 10);
+#endif
+      n++;
+      if (millis() - lastpoll >= PLOT_POLL_INTERVAL_MS) {
+        lastpoll = millis();
+        if (abortRequested()) break; // Abort with C
+#if PLOT_PROGRESSIVE
+        dbuffill(0); clearGraphBuffer(); // Draw the columns sampled so far
+        drawplot(n);
+        flush_dbuf_to_oled();
+#endif
+      }
+    }
+    mp = savedmp;
+    isplotcalc = false;
+    isplot = (n == GRAPH_PIXEL_WIDTH); // Render only a complete graph
+#if LOG_PLOT
+    Serial.print("[PLOT] sampled "); Serial.print(n); Serial.println(" columns");
+#endif
+    isprintscreen = true;
   }
 }
 static void _fnsolve(void) { // FN SOLVE
@@ -2781,28 +3409,13 @@ static void _integer(void) { // INTEGER
 }
 static void _inv(void) { // INV inv(a+jb)=a/(a*a+b*b)-i*b/(a*a+b*b)
   struct data a = dpop();
-  double denom = a.r * a.r + a.i * a.i;
-  if (denom == 0.0 || denom != denom) {
-    msgnr = MSGOVERFLOW;
-    return;
-  }
-  double realPart = a.r / denom;
-  double imagPart = -a.i / denom;
-
-  if (realPart != realPart || imagPart != imagPart) {
-    msgnr = MSGOVERFLOW;
-    return;
-  }
-
-  double realExponent = (realPart == 0.0) ? -1e6 : log10(_abs(realPart));
-  double imagExponent = (imagPart == 0.0) ? -1e6 : log10(_abs(imagPart));
-
-  if (realExponent > OVERFLOW || imagExponent > OVERFLOW) {
+  if (bothzero(a.r, a.i) || a.r != a.r || a.i != a.i) {
     msgnr = MSGOVERFLOW;
     return;
   }
-
-  dpush({realPart, imagPart, 0LL});
+  struct data z = zinv(a);
+  if (isoverflow(z.r) || isoverflow(z.i)) msgnr = MSGOVERFLOW;
+  else dpush(z);
 }
 static void _isreal(void) { // ISREAL?
   dpushr(isreal());
@@ -2847,10 +3460,17 @@ static void _ln(void) { // LN ln(a+i*b)=ln(r*exp(i*f))=ln(r)+i*f r=|a+i*b| f=ata
   struct data a = dpop();
   //Serial.print("LN: x="); Serial.print(a.r); Serial.print(" ln(x)="); Serial.println(log(a.r));
   if (absolute(a.r, a.i) == 0.0) msgnr = MSGOVERFLOW;
+  else if (a.i == 0.0 && a.r > 0.0) dpushr(log(a.r)); // Real
   else dpush({log(absolute(a.r, a.i)), angle(a.r, a.i) / RAD, 0LL});
 }
-static void _log(void) { // LOG
-  seekmem(_LOG);
+static void _log(void) { // LOG log(z)=ln(z)/ln(10)
+  struct data a = dpop();
+  if (a.r == 0.0 && a.i == 0.0) msgnr = MSGOVERFLOW;
+  else if (a.i == 0.0 && a.r > 0.0) dpushr(log10(a.r));
+  else {
+    struct data l = zln(a);
+    dpushz({l.r / log(10.0), l.i / log(10.0), 0LL});
+  }
 }
 static void _land(void) { // LOGIC AND
   seekmem(_AND);
@@ -2896,8 +3516,7 @@ static void _mstorcl(boolean issto) { // MRCL
       if (!commitBusinessSlot(businessVal)) msgnr = MSGSAVE;
     }
     else {
-      int64_t a;
-      EEPROM.get(EEMEMB, a);
+      int64_t a = readbusiness();
 #if LOG_FLASH_STORCL
       if (Serial) {
         Serial.print("[FLASH_STO] business slot read value=");
@@ -2967,8 +3586,7 @@ static void _mstorcl(boolean issto) { // MRCL
 #endif
       }
       else {
-        EEPROM.get(realAddr, a.r);
-        EEPROM.get(imagAddr, a.i);
+        readconst(tmp, a.r, a.i);
         a.b = 0LL; // Initialize business field
 #if LOG_FLASH_STORCL
         if (Serial) {
@@ -3221,6 +3839,12 @@ static void _rcl_ram(void) { // RCL-RAM wrapper function
 }
 static void _mul(void) { // MULT * (a+i*b)*(c+i*d)=(a*c-b*d)+i*(b*c+a*d)
   struct data b = dpop(), a = dpop();
+  if (a.i == 0.0 && b.i == 0.0) { // Real
+    double p = a.r * b.r;
+    if (!(_abs(p) <= OVERFLOWMAX)) msgnr = MSGOVERFLOW; // Includes NaN
+    else dpush({p, 0.0, (a.b * b.b) / 100LL});
+    return;
+  }
   double realPart = a.r * b.r - a.i * b.i;
   double imagPart = a.r * b.i + a.i * b.r;
 
@@ -3332,8 +3956,18 @@ static void _poke(void) { // ! POKE (value address poke)
   }
 }
 
-void _pow(void) { // POWER
-  seekmem(_POW);
+void _pow(void) { // POWER a^b=exp(b*ln(a)) 0^n=0
+  struct data b = dpop(), a = dpop();
+  if (a.r == 0.0 && a.i == 0.0) dpushr(0.0);
+  else if (a.i == 0.0 && b.i == 0.0 && (a.r > 0.0 || b.r == floor(b.r))) { // Real result
+    if (b.r * log(_abs(a.r)) > OVERFLOWEXP) msgnr = MSGOVERFLOW;
+    else dpushr(pow(a.r, b.r));
+  }
+  else {
+    struct data l = zmul(b, zln(a));
+    if (l.r > OVERFLOWEXP) msgnr = MSGOVERFLOW;
+    else dpushz(zexp(l));
+  }
 }
 static void _prgselect(void) { // PRG SELECT
   if (!base) {
@@ -3344,8 +3978,11 @@ static void _prgselect(void) { // PRG SELECT
 static void _pv(void) { // PV
   seekmem(_PV);
 }
-void _pwr10(void) { // POWER10
-  seekmem(_PWR10);
+void _pwr10(void) { // POWER10 10^z=exp(z*ln(10))
+  struct data a = dpop();
+  if (a.r * log(10.0) > OVERFLOWEXP) msgnr = MSGOVERFLOW;
+  else if (a.i == 0.0) dpushr(pow(10.0, a.r));
+  else dpushz(zexp({a.r * log(10.0), a.i * log(10.0), 0LL}));
 }
 static void _qe(void) { // QE
   seekmem(_QE);
@@ -3363,20 +4000,19 @@ static void _rot(void) { // ROT
 
   if (Serial) {
     Serial.print("[ROT] Before (bottom->top): ");
-    for (byte i = 0; i < dp; ++i) {
+    for (int i = 0; i < dp; ++i) {
       Serial.print(ds[i].r);
       if (i < dp - 1) Serial.print(", ");
     }
     Serial.println();
   }
 
-  struct data bottom = ds[0];
-  memmove(&ds[0], &ds[1], (dp - 1) * sizeof(struct data));
-  ds[dp - 1] = bottom;
+  if (dp < DATASTACKSIZE) ds[dp] = ds[0]; // Bottom to the free level above top
+  if (++ds.base == DATASTACKSIZE) ds.base = 0;
 
   if (Serial) {
     Serial.print("[ROT] After  (bottom->top): ");
-    for (byte i = 0; i < dp; ++i) {
+    for (int i = 0; i < dp; ++i) {
       Serial.print(ds[i].r);
       if (i < dp - 1) Serial.print(", ");
     }
@@ -3384,18 +4020,25 @@ static void _rot(void) { // ROT
   }
 }
 static void _sin(void) { // SIN sin(a+i*b)=sin(a)*cosh(b)+i*cos(a)*sinh(b)
-  if (isreal()) dpushr(sin(dpopr() / RAD));
+  double c;
+  if (isreal()) dpushr(degsin(dpopr(), &c));
   else {
     struct data a = dpop();
     double e = texp(a.i);
     dpush({sin(a.r) * (e + 1.0 / e) / 2.0, sin(PI / 2 - a.r) * (e - 1.0 / e) / 2.0, 0LL});
   }
 }
-static void _sinh(void) { // SINH
-  seekmem(_SINH);
+static void _sinh(void) { // SINH sinh(a+i*b)=sinh(a)*cos(b)+i*cosh(a)*sin(b)
+  struct data a = dpop();
+  if (a.r > OVERFLOWEXP || a.r < -OVERFLOWEXP) msgnr = MSGOVERFLOW;
+  else if (a.i == 0.0) dpushr(sinh(a.r));
+  else dpushz({sinh(a.r) * cos(a.i), cosh(a.r) * sin(a.i), 0LL});
 }
 static void _sqrt(void) { // SQRT
-  seekmem(_SQRT);
+  struct data a = dpop();
+  if (a.i != 0.0) dpushz(zsqrt(a));
+  else if (a.r < 0.0) dpush({0.0, sqrt(-a.r), 0LL});
+  else dpushr(sqrt(a.r));
 }
 static void _sub(void) { // SUB - a-b=a+(-b)
   if (base) {
@@ -3427,11 +4070,17 @@ static void _swap(void) { // SWAP
     dpush(a); dpush(b);
   }
 }
-static void _tan(void) { // TAN
-  seekmem(_TAN);
+static void _tan(void) { // TAN tan(z)=sin(z)/cos(z), real in degrees
+  struct data a = dpop();
+  double c;
+  if (a.i == 0.0) dpushz({degsin(a.r, &c) / c, 0.0, 0LL}); // TAN(90) overflows
+  else dpushz(zdiv({sin(a.r) * cosh(a.i), cos(a.r) * sinh(a.i), 0LL}, {cos(a.r) * cosh(a.i), -sin(a.r) * sinh(a.i), 0LL}));
 }
-static void _tanh(void) { // TANH
-  seekmem(_TANH);
+static void _tanh(void) { // TANH tanh(z)=sinh(z)/cosh(z)
+  struct data a = dpop();
+  if (a.i == 0.0) dpushr(tanh(a.r));
+  else if (a.r > OVERFLOWEXP || a.r < -OVERFLOWEXP) msgnr = MSGOVERFLOW;
+  else dpushz(zdiv({sinh(a.r) * cos(a.i), cosh(a.r) * sin(a.i), 0LL}, {cosh(a.r) * cos(a.i), sinh(a.r) * sin(a.i), 0LL}));
 }
 static void _torch(void) { // TORCH
   istorch = true;
@@ -3439,7 +4088,7 @@ static void _torch(void) { // TORCH
 static void _until(void) { // UNTIL
   if (!ap) msgnr = MSGNEST; // No BEGIN for this UNTIL
   else if (dpopr()) apop(); // Go on (delete return address)
-  else apush(mp = apop()); // Go back to BEGIN
+  else mp = as[ap - 1]; // Go back to BEGIN - its address stays for the next round
 }
 static void _usrset(void) { // USR
   if (!base) {
@@ -3468,6 +4117,8 @@ static void eepromMove(int from, int to, int length) { // Move EEPROM bytes hand
       EEPROM.put(to + offset, value);
     }
   }
+  usrindexed = 0; // Program addresses may have moved
+  tstale = true;
 }
 
 static double texp(double f) { // Calculate exp 
@@ -3506,6 +4157,54 @@ static boolean isreal(void) { // True if TOS is real
   return (dp ? ds[dp - 1].i == 0.0 : true);
 }
 
+// Complex kernels for the native math functions (radians)
+static struct data zmul(struct data a, struct data b) { // (a+i*b)*(c+i*d)=(a*c-b*d)+i*(b*c+a*d)
+  return {a.r * b.r - a.i * b.i, a.r * b.i + a.i * b.r, 0LL};
+}
+static struct data zdiv(struct data a, struct data b) { // a/b, Smith's algorithm - no |b|^2 to over- or underflow
+  if (_abs(b.r) >= _abs(b.i)) {
+    double t = b.i / b.r, d = b.r + b.i * t;
+    return {(a.r + a.i * t) / d, (a.i - a.r * t) / d, 0LL};
+  }
+  double t = b.r / b.i, d = b.r * t + b.i;
+  return {(a.r * t + a.i) / d, (a.i * t - a.r) / d, 0LL};
+}
+static struct data zinv(struct data b) { // 1/b, zdiv() with a=1
+  if (_abs(b.r) >= _abs(b.i)) {
+    double t = b.i / b.r, d = b.r + b.i * t;
+    return {1.0 / d, -t / d, 0LL};
+  }
+  double t = b.r / b.i, d = b.r * t + b.i;
+  return {t / d, -1.0 / d, 0LL};
+}
+static struct data zln(struct data a) { // ln(z)=ln|z|+i*arg(z)
+  return {log(absolute(a.r, a.i)), angle(a.r, a.i) / RAD, 0LL};
+}
+static struct data zexp(struct data a) { // exp(a+ib)=exp(a)*(cos(b)+i*sin(b))
+  double e = texp(a.r);
+  return {e * cos(a.i), e * sin(a.i), 0LL};
+}
+static struct data zsqrt(struct data a) { // Principal root, imaginary part takes sign of b
+  double r = absolute(a.r, a.i);
+  double im = sqrt((r - a.r) / 2.0);
+  return {sqrt((r + a.r) / 2.0), a.i < 0.0 ? -im : im, 0LL};
+}
+static struct data zasin(struct data a) { // asin(z)=-i*ln(i*z+sqrt(1-z*z))
+  struct data s = zsqrt({1.0 - (a.r * a.r - a.i * a.i), -2.0 * a.r * a.i, 0LL});
+  struct data l = zln({s.r - a.i, s.i + a.r, 0LL});
+  return {l.i, -l.r, 0LL};
+}
+static boolean isoverflow(double f) { // NaN, inf or beyond 10^OVERFLOW
+  return (f != f || (f != 0.0 && log10(_abs(f)) > OVERFLOW));
+}
+static void dpushz(struct data z) { // Push complex result with overflow check, round tiny imaginary part to 0
+  if (isoverflow(z.r) || isoverflow(z.i)) msgnr = MSGOVERFLOW;
+  else {
+    if (_abs(z.i) < TINYNUMBER * _abs(z.r)) z.i = 0.0;
+    dpush(z);
+  }
+}
+
 static void prgstepins(byte c) { // Insert step (character c in prgbuf at prgeditstart)
   Serial.print("prgstepins: c="); Serial.print(c);
   Serial.print(" prgeditstart="); Serial.print(prgeditstart);
@@ -3607,8 +4306,8 @@ static void execute(byte command) { // Execute command
   setfgm = 1;
 }
 
-static void floatstack() {
-  memcpy(ds, &ds[1], (DATASTACKSIZE - 1) * sizeof(struct data));
+static void floatstack() { // Drop bottom level
+  if (++ds.base == DATASTACKSIZE) ds.base = 0;
   dp--;
   isfloated = true;
 }
@@ -3665,10 +4364,10 @@ static int apop(void) { // Pop address (int) from address-stack
 }
 
 static void B2stack (void) { // Copy business stack to stack
-  for (byte i = 0; i < dp; i++)  ds[i].r = ds[i].b / 100.0;
+  for (int i = 0; i < dp; i++)  ds[i].r = ds[i].b / 100.0;
 }
 static void stack2B (void) { // Copy stack to business stack
-  for (byte i = 0; i < dp; i++)
+  for (int i = 0; i < dp; i++)
     ds[i].b = (ds[i].r * 1000LL + 5LL) / 10LL; // Includes rounding
 }
 
@@ -3676,7 +4375,11 @@ static int seekusr(byte n) { // Find run-address (ptr) of n-th function
     byte original = n;
     int ptr = EEUSTART;
     int bytesScanned = 0;
-    while (n >= MAXCMDB) {
+    if (n >= MAXCMDB && n - MAXCMDB < usrindexed) { // Indexed
+        ptr = usrptr[n - MAXCMDB];
+        n = 0;
+    }
+    while (n >= MAXCMDB) { // Not indexed - scan flash
         byte value;
         EEPROM.get(ptr++, value);
         bytesScanned++;
@@ -3736,11 +4439,7 @@ static void seekmem(byte n) { // Find run-address (mp) of n-th builtin function
     }
 #endif
 
-    mp = 0;
-    while (n + 1 - MAXCMDI) {
-        if (mem[mp++] == _END)
-            n--;
-    }
+    mp = memofs[n - _BUS];
 #if LOG_SEEKMEM
     if (Serial) {
         Serial.print("[SEEKMEM] Set mp to builtin="); Serial.println(mp);
@@ -3942,14 +4641,10 @@ static void moveprgup(void) { // Move program in EEPROM up
 #endif
     
     // Fix menu references (menu is in config area, preserved separately)
-    uint8_t menuBuf[MENUITEMS];
-    for (int i = 0; i < MENUITEMS; ++i) {
-      EEPROM.get(EEMENU + i, menuBuf[i]);
-      if (menuBuf[i] == cmd1) menuBuf[i] = cmd2;
-      else if (menuBuf[i] == cmd2) menuBuf[i] = cmd1;
-    }
     for (int i = 0; i < MENUITEMS; ++i) {
-      EEPROM.put(EEMENU + i, menuBuf[i]);
+      byte entry = readmenu(i);
+      if (entry == cmd1) commitMenuSlot(i, cmd2);
+      else if (entry == cmd2) commitMenuSlot(i, cmd1);
     }
     
     sort(); // Refresh program list
@@ -4156,12 +4851,9 @@ static void moveprgtop(void) { // Move selected program directly to the top in P
   bool rewriteOk = rewriteUserAreaImage(rebuilt, writeIdx, "move-top", nullptr);
   if (rewriteOk) {
     for (int i = 0; i < MENUITEMS; ++i) {
-      byte entry;
-      EEPROM.get(EEMENU + i, entry);
-      if (entry >= MAXCMDB && entry < MAXCMDB + nou) {
-        byte idx = entry - MAXCMDB;
-        EEPROM.put(EEMENU + i, MAXCMDB + newIndex[idx]);
-      }
+      byte entry = readmenu(i);
+      if (entry >= MAXCMDB && entry < MAXCMDB + nou && newIndex[entry - MAXCMDB] != entry - MAXCMDB)
+        commitMenuSlot(i, MAXCMDB + newIndex[entry - MAXCMDB]);
     }
     sort();
     prgselect = 0;
@@ -4205,7 +4897,8 @@ static byte menuselect(byte lines) { // Selection (1 line = 16 items)
   return (PRINTNOKEY);
 }
 
-static void idofusr(void) {
+template <typename Reader>
+static void indexusr(Reader at, int length) { // Rebuild usrptr[], nou and sou from a user area image
     /*Always stop immediately when double _END is found, even if next bytes are printable.
     Avoid counting any function that appears after _END _END.
     The continue vs break matters — continue could allow reading garbage, break stops the loop 
@@ -4213,25 +4906,24 @@ static void idofusr(void) {
 #if LOG_IDOFUSR
     Serial.println("idofusr: Starting program count");
 #endif
-    int ptr = EEUSTART;
-    boolean loop = true;
+    int ptr = 0;
+    boolean loop = true, terminated = false;
     byte n = 0;
-    byte tmp1 = EEPROM[ptr];
+    byte tmp1 = at(ptr);
 #if LOG_IDOFUSR
-    Serial.print("idofusr: Initial ptr="); Serial.print(ptr); Serial.print(" tmp1="); Serial.println(tmp1);
+    Serial.print("idofusr: Initial ptr="); Serial.print(EEUSTART + ptr); Serial.print(" tmp1="); Serial.println(tmp1);
 #endif
 
-//while (loop && n < 40 && ptr + 3 < EEUSTART + 8192) {  // do not read past allocated 8KB
-while (loop && n < 40 && ptr + 3 < EEUSTART + 32768) {  // do not read past allocated 32KB
-    byte tmp2 = EEPROM[++ptr];                         // needs changing when FLASH_PAGE_SIZE changes
+while (loop && n < MAXCMDU - MAXCMDB && ptr + 3 < length) {  // do not read past the user area
+    byte tmp2 = at(++ptr);
 #if LOG_IDOFUSR
-    Serial.print("idofusr: ptr="); Serial.print(ptr); Serial.print(" tmp1="); Serial.print(tmp1); Serial.print(" tmp2="); Serial.println(tmp2);
+    Serial.print("idofusr: ptr="); Serial.print(EEUSTART + ptr); Serial.print(" tmp1="); Serial.print(tmp1); Serial.print(" tmp2="); Serial.println(tmp2);
 #endif
     if (tmp1 == _END) {
         char testName[3];
-        testName[0] = EEPROM[ptr + 1];
-        testName[1] = EEPROM[ptr + 2];
-        testName[2] = EEPROM[ptr + 3];
+        testName[0] = at(ptr + 1);
+        testName[1] = at(ptr + 2);
+        testName[2] = at(ptr + 3);
 #if LOG_IDOFUSR
         Serial.print("idofusr: testName="); Serial.print(testName[0]); Serial.print(testName[1]); Serial.println(testName[2]);
 #endif
@@ -4254,9 +4946,11 @@ while (loop && n < 40 && ptr + 3 < EEUSTART + 32768) {  // do not read past allo
             Serial.println("idofusr: Double END found, stopping");
 #endif
             loop = false;
+            terminated = true;
             continue;
         } else if (hasValidChar) {
-            n++;
+            for (byte j = 0; j < PRGNAMEMAX; j++) usrname[n][j] = at(ptr + j);
+            usrptr[n++] = EEUSTART + ptr;
 #if LOG_IDOFUSR
             Serial.print("idofusr: Valid program found, n="); Serial.println(n);
 #endif
@@ -4271,19 +4965,187 @@ while (loop && n < 40 && ptr + 3 < EEUSTART + 32768) {  // do not read past allo
 }
 
     nou = n;
-    sou = ptr + 1 - EEUSTART;
+    sou = ptr + 1;
+    usrptr[n] = EEUSTART + ptr;
+    usrindexed = terminated ? n + 1 : n; // Terminator address only trusted after double _END
+    tstale = true; // Call targets may have moved
+    dictstale = true;
 #if LOG_IDOFUSR
     Serial.print("idofusr: Final nou="); Serial.print(nou); Serial.print(" sou="); Serial.println(sou);
 #endif
 }
 
-static boolean isValidPrgName(char *name) {
-  // Check if a program name is valid (not gibberish)
-  // Valid names should NOT have control characters or non-ASCII
+static void idofusr(void) { // Count nou and sou - scans flash only if the index is stale
+  if (usrindexed || loaddir()) return;
+  indexusr([](int i) -> byte { return EEPROM[EEUSTART + i]; }, userAreaCapacity());
+  savedir(); // Skip the scan on next boot
+}
 
-  bool hasMeaningfulChar = false; // At least one useful printable character
+static void dictinsert(byte c);
 
-  for (byte i = 0; i < PRGNAMEMAX; i++) {
+static void appendusr(int addr, int len) { // Index a program of len steps just written at the list end
+  tstale = true;
+  if (!usrindexed || nou >= MAXCMDU - MAXCMDB) {
+    usrindexed = 0; // Fall back to a flash scan
+    dictstale = true;
+    return;
+  }
+  for (byte i = 0; i < PRGNAMEMAX; i++) usrname[nou][i] = EEPROM[addr + i];
+  if (!dictstale) dictinsert(MAXCMDB + nou);
+  usrptr[nou++] = addr;
+  usrptr[nou] = addr + PRGNAMEMAX + len + 1; // List terminator after the program's _END
+  usrindexed = nou + 1;
+  sou = usrptr[nou] + 1 - EEUSTART;
+  savedir();
+}
+
+// Static stack effect of programs - checked when a program is saved or loaded
+#define FXVAR 0xff // cmdfx[]: effect depends on data, mode or user input
+static const byte cmdfx[] PROGMEM = { // Stack effect of builtin commands in decimal mode: levels read << 4 | levels left
+  0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, // Digits - number entry is handled by verifyfx()
+  0x01, 0x12, 0x10, 0x11, 0x21, 0x00, // . DUP DROP NEG E F
+
+  FXVAR, 0x11, FXVAR, 0x21, // CMPLX RCL SOLVE SUB
+  0x00, FXVAR, 0x21, 0x21, // DICT F(X) MULT SUM+
+  0x00, 0x21, 0x00, 0x21, // PRG DIV R<>P ADD
+  FXVAR, 0x23, 0x22, 0x00, // CLR OVER SWAP G
+  0x01, 0x20, FXVAR, 0x00, // BATT STO INTEGRATE LIT-
+  0x00, FXVAR, 0x00, 0x00, // USR PLOT TORCH SUMCLR
+  FXVAR, 0x21, FXVAR, 0x00, // BASE MOD CLOCK LIT+
+  0x10, 0x11, 0x00, 0x00, // OFF PICK (index in range) ROT (whole stack) G-OFF
+
+  0x21, 0x21, 0x21, 0x21, // < = <> >
+  0x21, 0x11, 0x10, 0x11, // NAND ADDDUR PAUSE INT
+  0x11, 0x20, 0x00, 0x10, // PEEK POKE BEGIN UNTIL
+  FXVAR, 0x10, 0x00, 0x00, // EXE IF ELSE THEN
+
+  0x00, 0x01, 0x00, 0x10, // BREAK KEY ACLR APUT
+  0x01, 0x21, 0x21, 0x01, // ISREAL COMB PERM PI
+  0x11, 0x11, 0x11, 0x11, // INV SIN EXP LN
+
+  FXVAR, FXVAR, 0x21, 0x11, // BUS HEX AND NOT
+  0x21, 0x23, 0x11, 0x11, // OR OVER ABS SQRT
+  0x11, 0x11, 0x21, 0x11, // COS TAN POW PWR10
+  0x11, 0x11, 0x11, 0x11, // LOG ASIN ACOS ATAN
+  0x11, 0x11, 0x11, 0x11, // SINH COSH TANH ASINH
+  0x11, 0x11, 0x11, 0x11, // ACOSH ATANH GAMMALN HMS2H
+  0x11, 0x21, 0x12, 0x22, // H2HMS PV ND QE
+  FXVAR, 0x00, 0x21, 0x21, // CLOCK SUMCLR SUM+ SUM-
+  0x02, 0x02, 0x22, 0x22, // STAT LR % DELTA%
+  0x11, 0x12, 0x12, 0x12, // FRAC DEG<>RAD C<>F KM<>MI
+  0x12, 0x12, 0x12, 0x12, // M<>FT CM<>IN KG<>LBS L<>GAL
+
+  0x20, 0x11, // STR RCR
+};
+static_assert(sizeof(cmdfx) == MAXCMDB && sizeof(cmdfx) == sizeof(dispatch) / sizeof(dispatch[0]), "cmdfx[] needs one entry per builtin in dispatch[]");
+
+#define FXOK         0 // Effect known and balanced
+#define FXVARIES     1 // Effect depends on run time - not an error
+#define FXUNBALANCED 2 // IF/ELSE/THEN or BEGIN/UNTIL mismatch, or branches with different effects
+#define FXNEST       8 // Max IF and BEGIN levels checked
+#define FXCALLS      4 // Max depth of user program calls checked
+
+struct stackfx { // Static stack effect of a program
+  int net;   // Change of dp
+  int depth; // Maximum growth of dp
+  int nest;  // Maximum use of the address stack
+};
+
+struct codeat { // Reader for program bytes from run-address base on
+  int base;
+  byte operator()(int i) const { return fetchcode(base + i); }
+};
+
+static byte verifyusr(byte c, stackfx& fx, byte calls);
+
+template <typename Reader>
+static byte verifyfx(Reader at, int len, stackfx& fx, byte calls) { // Stack effect of len steps (or up to _END)
+  int h = 0, lvl = 0; // Stack height relative to entry, IF/BEGIN level
+  int frame[FXNEST], other[FXNEST]; // Height at IF/BEGIN, height at end of the IF branch
+  byte kind[FXNEST]; // _IF, _ELSE (IF branch done) or _BEGIN
+  boolean entering = false; // Number entry - digits append to TOS
+  byte r = FXOK;
+  fx = {0, 0, 0};
+  for (int a = 0; a < len; a++) {
+    byte c = at(a);
+    if (c == _END) break;
+    if (c <= _DOT) { // Digit or dot - starts a number unless one is being entered
+      if (!entering) h++;
+      entering = true;
+    }
+    else if (entering && c == _DROP) return (FXVARIES); // Clear entry
+    else if (entering && c == _DUP) entering = false; // DUP ends the entry only
+    else {
+      entering = false;
+      byte e;
+      if (c >= MAXCMDB) { // User program call
+        stackfx u;
+        if (c >= MAXCMDU || calls >= FXCALLS || (e = verifyusr(c, u, calls + 1)) == FXVARIES) return (FXVARIES);
+        if (e == FXUNBALANCED) r = FXUNBALANCED;
+        fx.depth = max(fx.depth, h + u.depth);
+        fx.nest = max(fx.nest, lvl + 1 + u.nest); // Return address
+        h += u.net;
+        continue;
+      }
+      if ((e = cmdfx[c]) == FXVAR) return (FXVARIES);
+      h += (e & 0x0f) - (e >> 4);
+      if (c == _IF || c == _BEGIN) {
+        if (lvl >= FXNEST) return (FXVARIES);
+        kind[lvl] = c; frame[lvl++] = h;
+        if (c == _BEGIN) fx.nest = max(fx.nest, lvl);
+      }
+      else if (c == _ELSE) {
+        if (!lvl || kind[lvl - 1] != _IF) return (FXUNBALANCED);
+        kind[lvl - 1] = _ELSE; other[lvl - 1] = h; h = frame[lvl - 1]; // ELSE branch starts like the IF branch
+      }
+      else if (c == _THEN) {
+        if (!lvl || kind[lvl - 1] == _BEGIN) return (FXUNBALANCED);
+        lvl--;
+        if (h != (kind[lvl] == _ELSE ? other[lvl] : frame[lvl])) r = FXUNBALANCED; // Branches leave different heights
+      }
+      else if (c == _UNTIL) {
+        if (!lvl || kind[lvl - 1] != _BEGIN) return (FXUNBALANCED);
+        if (h != frame[--lvl]) r = FXUNBALANCED; // Loop grows or shrinks the stack
+      }
+    }
+    fx.depth = max(fx.depth, h);
+  }
+  if (lvl) return (FXUNBALANCED); // IF or BEGIN left open
+  fx.net = h;
+  return (r);
+}
+
+static byte verifyusr(byte c, stackfx& fx, byte calls) { // Stack effect of user program c
+  if (c - MAXCMDB >= usrindexed) return (FXVARIES);
+  int start = usrptr[c - MAXCMDB] + PRGNAMEMAX - EEUSTART + sizeof(mem);
+  return (verifyfx(codeat{start}, sizeof(mem) + sou - start, fx, calls));
+}
+
+static void verifyprg(void) { // Check the stack effect of prgbuf - NEST ERROR if unbalanced or too deeply nested
+  stackfx fx;
+  byte r = verifyfx([](int i) -> byte { return prgbuf[i]; }, prgbuflen, fx, 0);
+  if (r == FXUNBALANCED || (r == FXOK && fx.nest > ADDRSTACKSIZE)) msgnr = MSGNEST;
+  else if (r == FXOK && (fx.depth > DATASTACKSIZE)) msgnr = MSGOVERFLOW; // Stack floats
+#if LOG_VERIFY
+  if (Serial) {
+    Serial.print("[VERIFY] len="); Serial.print(prgbuflen);
+    if (r == FXVARIES) Serial.println(" effect varies");
+    else {
+      Serial.print(r == FXOK ? " ok" : " UNBALANCED");
+      Serial.print(" net="); Serial.print(fx.net);
+      Serial.print(" depth="); Serial.print(fx.depth); Serial.print(" nest="); Serial.println(fx.nest);
+    }
+  }
+#endif
+}
+
+static boolean isValidPrgName(char *name) {
+  // Check if a program name is valid (not gibberish)
+  // Valid names should NOT have control characters or non-ASCII
+
+  bool hasMeaningfulChar = false; // At least one useful printable character
+
+  for (byte i = 0; i < PRGNAMEMAX; i++) {
     byte c = (byte)name[i];
     // Check for obviously invalid characters
     if (c == 0) continue;  // NULL is OK as terminator
@@ -4309,55 +5171,35 @@ static boolean isValidPrgName(char *name) {
 }
 
 
-static void sort(void) { // Sort cmd[] alphabetically to cmdsort[]
+static int cmdcmp(byte a, byte b) { // Compare command names like strcmp
+  return strncmp(a < MAXCMDB ? cmd[a] : usrname[a - MAXCMDB], b < MAXCMDB ? cmd[b] : usrname[b - MAXCMDB], PRGNAMEMAX);
+}
+
+static void dictinsert(byte c) { // Insert command c behind its equals in the sorted part of cmdsort[]
+  byte n = c, lo = 0, hi = c; // Commands below c are already sorted
+  while (lo < hi) {
+    byte mid = (lo + hi) / 2;
+    if (cmdcmp(cmdsort[mid], c) <= 0) lo = mid + 1; else hi = mid;
+  }
+  memmove(cmdsort + lo + 1, cmdsort + lo, n - lo);
+  cmdsort[lo] = c;
+}
+
+static void sort(void) { // Merge user program names into the builtin order of cmdsort[]
   idofusr(); // Calculate nou first
-  char s[2][4]; // Strings to compare
-  for (byte i = 0; i < MAXCMDU; i++) cmdsort[i] = i; // Initialize
-  for (byte k = MAXCMDB + nou - 1; k > 0; k--) { // Outer loop
-    for (byte i = 0; i < k; i++) { // Inner loop
-      for (byte m = 0; m < 2; m++) { // Catch 2 strings
-        if (cmdsort[i + m] < MAXCMDB) // Intrinsic or builtin command
-          //strcpy_P(s[m], (char*)pgm_read_word(&(cmd[cmdsort[i + m]])));
-          strcpy(s[m], cmd[cmdsort[i + m]]); 
-        /*else { // User command
-          int ptr = seekusr(cmdsort[i + m]);
-          for (byte j = 0; j < 3; j++) s[m][j] = EEPROM[ptr++];
-        }*/
-        else if (cmdsort[i + m] >= MAXCMDB && cmdsort[i + m] < MAXCMDB + nou) { 
-          int ptr = seekusr(cmdsort[i + m]);
-          for (byte j = 0; j < 3 && (ptr + j) < EEUSTART + sou; j++) 
-            s[m][j] = EEPROM[ptr + j];
-        } else {
-          // invalid entry: fill with blanks
-          s[m][0] = s[m][1] = s[m][2] = ' ';
-        }
-      }
-      if (strcmp(s[0], s[1]) > 0) { // Compare strings and swap commands
+  if (!dictstale) return;
+  if (!cmdordered) { // Order builtins once - follows cmd[] when it changes
+    for (byte c = 0; c < MAXCMDB; c++) dictinsert(c);
+    memcpy(cmdorder, cmdsort, MAXCMDB);
+    cmdordered = true;
+  }
+  memcpy(cmdsort, cmdorder, MAXCMDB);
+  for (byte i = MAXCMDB; i < MAXCMDU; i++) cmdsort[i] = i;
+  for (byte k = 0; k < nou; k++) dictinsert(MAXCMDB + k);
+  dictstale = false;
 #if LOG_SORT
-        if (Serial) {
-          Serial.print("[sort] swap i="); Serial.print(i);
-          Serial.print(" A="); Serial.print(s[0]);
-          Serial.print(" B="); Serial.print(s[1]);
-          Serial.print(" ids="); Serial.print(cmdsort[i]); Serial.print('/'); Serial.print(cmdsort[i + 1]);
-          if (cmdsort[i] >= MAXCMDB) {
-            int addrA = seekusr(cmdsort[i]);
-            Serial.print(" @A=0x"); Serial.print(addrA, HEX);
-          } else {
-            Serial.print(" @A=builtin");
-          }
-          if (cmdsort[i + 1] >= MAXCMDB) {
-            int addrB = seekusr(cmdsort[i + 1]);
-            Serial.print(" @B=0x"); Serial.print(addrB, HEX);
-          } else {
-            Serial.print(" @B=builtin");
-          }
-          Serial.println();
-        }
+  Serial.print("[sort] merged nou="); Serial.println(nou);
 #endif
-        byte tmp = cmdsort[i]; cmdsort[i] = cmdsort[i + 1]; cmdsort[i + 1] = tmp;
-      }
-    }
-  }
 }
 
 static void printbuf(boolean shift, byte mh, byte y) { // Print sbuf[]
@@ -4476,8 +5318,12 @@ static void printsci(double f, boolean bitshift, byte mh, byte y) { // Print flo
   printbuf(bitshift, mh, y);
 }
 
+static byte stackletter(int n) { // Indicator of stack level n - levels above z show z
+  return (n < 26 ? 'a' + n : 'z');
+}
+
 static void printbase() { // Print TOS for base (10 or other)
-  printcat(dp ? dp - 1 + 'a' : 'B', FONT4, false, SIZES, SIZES, 0, 0); // Base indicator
+  printcat(dp ? stackletter(dp - 1) : 'B', FONT4, false, SIZES, SIZES, 0, 0); // Base indicator
   printint(base, false, (base < 10) ? 60 : 55, 0); // Print base
   int64_t n = 0; 
   if (dp) n = ds[dp - 1].b;
@@ -4553,7 +5399,7 @@ static void printxy() { // Print X, Y (2 complex numbers max, each uses 2 lines:
     // TOS is complex: show real (line 3) and imaginary (line 2)
     double realPart = ds[dp - 1].r;
     double imagPart = ds[dp - 1].i;
-    byte indReal = dp ? 'a' + dp - 1 : '}';
+    byte indReal = dp ? stackletter(dp - 1) : '}';
     byte indImag = ispolar ? '`' : 'i';
     
     if (ispolar) {
@@ -4573,7 +5419,7 @@ static void printxy() { // Print X, Y (2 complex numbers max, each uses 2 lines:
       // NOS is also complex: show real (line 1) and imaginary (line 0)
       double nos_real = ds[dp - 2].r;
       double nos_imag = ds[dp - 2].i;
-      byte nos_indReal = 'a' + dp - 2;
+      byte nos_indReal = stackletter(dp - 2);
       byte nos_indImag = ispolar ? '`' : 'i';
       
       if (ispolar) {
@@ -4590,7 +5436,7 @@ static void printxy() { // Print X, Y (2 complex numbers max, each uses 2 lines:
     }
     else if (dp > 1 && !isprintalpha) {
       // NOS is real: show on line 1 only
-      printnum(ds[dp - 2].r, false, siz, 1, 'a' + dp - 2);
+      printnum(ds[dp - 2].r, false, siz, 1, stackletter(dp - 2));
 #if LOG_COMPLEX
       Serial.print("[COMPLEX_DEBUG] NOS real displayed: "); Serial.println(ds[dp - 2].r);
 #endif
@@ -4599,11 +5445,11 @@ static void printxy() { // Print X, Y (2 complex numbers max, each uses 2 lines:
   else if (nos_complex) {
     // TOS is real, but NOS is complex: show TOS on line 3, then NOS complex on lines 1+0
     double tos_real = ds[dp - 1].r;
-    byte tos_ind = 'a' + dp - 1;
+    byte tos_ind = stackletter(dp - 1);
     
     double nos_real = ds[dp - 2].r;
     double nos_imag = ds[dp - 2].i;
-    byte nos_indReal = 'a' + dp - 2;
+    byte nos_indReal = stackletter(dp - 2);
     byte nos_indImag = ispolar ? '`' : 'i';
     
     if (ispolar) {
@@ -4629,9 +5475,9 @@ static void printxy() { // Print X, Y (2 complex numbers max, each uses 2 lines:
     double third_real = ds[dp - 3].r;
     double third_imag = ds[dp - 3].i;
     
-    byte tos_ind = 'a' + dp - 1;
-    byte nos_ind = 'a' + dp - 2;
-    byte third_indReal = 'a' + dp - 3;
+    byte tos_ind = stackletter(dp - 1);
+    byte nos_ind = stackletter(dp - 2);
+    byte third_indReal = stackletter(dp - 3);
     byte third_indImag = ispolar ? '`' : 'i';
     
     if (ispolar) {
@@ -4666,13 +5512,13 @@ static void printxy() { // Print X, Y (2 complex numbers max, each uses 2 lines:
         ca = 's';  // seconds why reverse order? I don't get it. 
         cb = 'm';  // minutes
         cc = 'h';  // hours 
-        cd = (dp > 3) ? 'a' + dp - 4 : '-'; // 4th stack level still uses letter indicator
+        cd = (dp > 3) ? stackletter(dp - 4) : '-'; // 4th stack level still uses letter indicator
     } else {
         // Normal mode: show stack level indicators
-        ca = dp ? 'a' + dp - 1 : '}';
-        cb = (dp > 1) ? 'a' + dp - 2 : '-';
-        cc = (dp > 2) ? 'a' + dp - 3 : '-';
-        cd = (dp > 3) ? 'a' + dp - 4 : '-';
+        ca = dp ? stackletter(dp - 1) : '}';
+        cb = (dp > 1) ? stackletter(dp - 2) : '-';
+        cc = (dp > 2) ? stackletter(dp - 3) : '-';
+        cd = (dp > 3) ? stackletter(dp - 4) : '-';
     }
     
     // Check if 4th position is complex
@@ -4755,7 +5601,7 @@ static boolean printscreen(void) { // Print screen
         for (byte i = 0; i < 4; i++) {
             byte tmp = sel * 4 + i;
            
-            if (ismenu) EEPROM.get(EEMENU + tmp, tmp);
+            if (ismenu) tmp = readmenu(tmp);
             else tmp = cmdsort[tmp];
 
             memset(sbuf, 0, sizeof(sbuf));
@@ -4765,10 +5611,8 @@ static boolean printscreen(void) { // Print screen
                 sbuf[sizeof(sbuf)-1] = '\0';
             }
             else if (tmp < MAXCMDB + nou) { // User command
-                int ptr = seekusr(tmp);
-                memset(sbuf, 0, sizeof(sbuf)); // Clear sbuf before reading
-                for (byte j = 0; j < 3; j++) sbuf[j] = EEPROM[ptr++];
-                sbuf[3] = '\0';
+                memcpy(sbuf, usrname[tmp - MAXCMDB], PRGNAMEMAX);
+                sbuf[PRGNAMEMAX] = '\0';
             }
             else {
                 sbuf[0] = ' '; sbuf[1] = '_'; sbuf[2] = '\0'; // correct: null terminator for a char array
@@ -4879,71 +5723,169 @@ static boolean printscreen(void) { // Print screen
             printcat('{', FONT4, false, SIZES, SIZES, 0, 0);
         }
     }
-    else if (isplot) { // Plot
-        double ymax = plot[0], ymin = plot[0];
-        for (byte i = 0; i < GRAPH_PIXEL_WIDTH; i++) { // Find ymax and ymin
-            ymax = max(ymax, plot[i]); ymin = min(ymin, plot[i]);
-        }
+    else if (isplot) drawplot(GRAPH_PIXEL_WIDTH); // Plot
+    else printxy();
 
-        double yspan = ymax - ymin;
-        bool isFlatLine = fabs(yspan) < 1e-12;
-        double yscaleForLog = isFlatLine ? 0.0 : yspan / (GRAPH_PIXEL_HEIGHT - 1);
-        auto mapSampleToPixel = [&](double sample) -> int {
-            if (isFlatLine) return GRAPH_PIXEL_HEIGHT / 2;
-            double relative = (sample - ymin) / (yspan == 0.0 ? 1.0 : yspan);
-            if (relative < 0.0) relative = 0.0;
-            else if (relative > 1.0) relative = 1.0;
-            return (int)lround((GRAPH_PIXEL_HEIGHT - 1) * (1.0 - relative));
-        };
-#if LOG_PLOT
-        Serial.print("[PLOT] render ymin="); Serial.print(ymin, 10);
-        Serial.print(" ymax="); Serial.print(ymax, 10);
-        Serial.print(" yscale="); Serial.print(yscaleForLog, 10);
-        Serial.print(" firstSample="); Serial.print(plot[0], 10);
-        Serial.print(" lastSample="); Serial.println(plot[GRAPH_PIXEL_WIDTH - 1], 10);
-#endif
-        if (plota * plotb <= 0) printvline(-plota * (GRAPH_PIXEL_WIDTH / (plotb - plota))); // Y-axis
-        if (ymin * ymax <= 0) printhline(mapSampleToPixel(0.0)); // X-axis
-
-        // Draw smooth lines between consecutive points instead of just plotting pixels
-        int prevX = -1, prevY = -1;
-        for (byte i = 0; i < GRAPH_PIXEL_WIDTH; i++) {
-            int currX = i;
-            double relative = isFlatLine ? 0.5 : (plot[i] - ymin) / (yspan == 0.0 ? 1.0 : yspan);
-            double unclampedRelative = relative;
-            if (relative < 0.0) relative = 0.0;
-            else if (relative > 1.0) relative = 1.0;
-            int currY = (int)lround((GRAPH_PIXEL_HEIGHT - 1) * (1.0 - relative));
-            
-#if LOG_PLOT
-            if (!isFlatLine && (unclampedRelative < 0.0 || unclampedRelative > 1.0)) {
-                Serial.print("[PLOT] clipped sample idx="); Serial.print(i);
-                Serial.print(" x="); Serial.print(currX);
-                Serial.print(" unclampedNorm="); Serial.print(unclampedRelative, 10);
-                Serial.print(" ymin="); Serial.print(ymin, 10);
-                Serial.print(" ymax="); Serial.print(ymax, 10);
-                Serial.print(" sample="); Serial.println(plot[i], 10);
-            }
+    if (isprintalpha) printsat(alpha, false, SIZES, SIZES, 0, 0); // Print alpha anyway
+
+    flush_dbuf_to_oled(); // The only transfer of this frame
+    oledframes++;
+#if LOG_FRAMES
+    Serial.print("[FRAME] frames="); Serial.print(oledframes);
+    Serial.print(" flushes="); Serial.print(oledflushes);
+    Serial.print(" pages="); Serial.println(oledpagessent);
 #endif
+    return (NULL); // to determine isprintscreen
+}
 
-            if (prevX == -1) {
-                // First point - just plot it
-                printpixel(currX, currY);
-            } else {
-                // Draw line from previous point to current point
-                drawLine(prevX, prevY, currX, currY);
-            }
-            
-            prevX = currX;
-            prevY = currY;
-        }
+// REGISTER JOURNAL
+// STO, business and menu writes append a record behind the user area instead of rotating the page.
+// Record: header word {kind, slot, payload size, commit} + payload padded to words. The commit byte
+// is cleared after the payload, so a torn record is skipped. Latest record wins; RAM index below.
+// The journal is folded into the config region whenever the page rotates (see snapshotConfig).
+// It also holds the program directory (usrptr[] offsets and names) so boot can skip the user area scan.
+#define JCONST 1 // Record kinds
+#define JBUS   2
+#define JMENU  3
+#define JDIR   4 // Program directory - variable size
+#define JDIRSIZE(n) (3 + (n) * (2 + PRGNAMEMAX) + 2) // Count, sou, n x {offset, name}, checksum
+#define JCOMMITTED 0x00
+static int16_t jconst[MEMNR], jmenu[MENUITEMS], jbus; // Journal offset of latest payload, -1 = config region
+static int16_t jdir; // Journal offset of latest program directory, -1 = none
+static int jend; // Journal offset of first free byte
+static boolean jindexed; // Index valid for the active page
+
+static byte jsize(byte kind) { // Payload size of record kind (maximum for JDIR)
+  return kind == JCONST ? 2 * sizeof(double) : kind == JBUS ? sizeof(int64_t) : kind == JMENU ? 1 :
+         kind == JDIR ? JDIRSIZE(MAXCMDU - MAXCMDB) : 0;
+}
+
+static void jindex(void) { // Scan journal and index latest committed record of each register
+  for (byte i = 0; i < MEMNR; i++) jconst[i] = -1;
+  for (byte i = 0; i < MENUITEMS; i++) jmenu[i] = -1;
+  jbus = jdir = -1;
+  jindexed = true;
+  if (jlegacy) { // Space holds programs - appends fail and writes rotate the page
+    jend = EEJOURNALSIZE;
+    return;
+  }
+  for (jend = 0; jend + 4 <= EEJOURNALSIZE; ) {
+    byte h[4];
+    EEPROM.get(EEJOURNAL + jend, h);
+    if (h[0] == 0xFF) break; // Blank - end of journal
+    byte n = h[2];
+    if (!jsize(h[0]) || (h[0] == JDIR ? n > jsize(JDIR) : n != jsize(h[0])) || jend + 4 + ((n + 3) & ~3) > EEJOURNALSIZE) { // Not a record - compact on next write
+      jend = EEJOURNALSIZE;
+      break;
     }
-    else printxy();
+    if (h[3] == JCOMMITTED) {
+      if (h[0] == JCONST && h[1] < MEMNR) jconst[h[1]] = jend + 4;
+      else if (h[0] == JBUS) jbus = jend + 4;
+      else if (h[0] == JMENU && h[1] < MENUITEMS) jmenu[h[1]] = jend + 4;
+      else if (h[0] == JDIR) jdir = jend + 4;
+    }
+    jend += 4 + ((n + 3) & ~3);
+  }
+}
+
+static boolean jappend(byte kind, byte slot, const void* payload, byte n = 0) { // Append record - false if journal is full
+  if (!jindexed) jindex();
+  if (!n) n = jsize(kind);
+  if (jend + 4 + ((n + 3) & ~3) > EEJOURNALSIZE) return false;
+  int at = EEJOURNAL + jend;
+  byte h[4] = {kind, slot, n, 0xFF};
+  EEPROM.put(at, h);
+  EEPROM.programRange(at + 4, (const byte*)payload, n);
+  EEPROM.put(at + 3, (byte)JCOMMITTED);
+  if (kind == JCONST) jconst[slot] = jend + 4;
+  else if (kind == JBUS) jbus = jend + 4;
+  else if (kind == JDIR) jdir = jend + 4;
+  else jmenu[slot] = jend + 4;
+  jend += 4 + ((n + 3) & ~3);
+  return true;
+}
 
-    if (isprintalpha) printsat(alpha, false, SIZES, SIZES, 0, 0); // Print alpha anyway
+static void readconst(byte slot, double& r, double& i) { // Latest value of constant register
+  if (!jindexed) jindex();
+  if (jconst[slot] >= 0) {
+    EEPROM.get(EEJOURNAL + jconst[slot], r);
+    EEPROM.get(EEJOURNAL + jconst[slot] + sizeof(double), i);
+  }
+  else {
+    EEPROM.get(EEMEM + slot * sizeof(double), r);
+    EEPROM.get(EEMEM + (slot + MEMNR) * sizeof(double), i);
+  }
+}
 
-    flush_dbuf_to_oled(); 
-    return (NULL); // to determine isprintscreen
+static int64_t readbusiness(void) { // Latest value of business register
+  if (!jindexed) jindex();
+  int64_t b;
+  EEPROM.get(jbus >= 0 ? EEJOURNAL + jbus : EEMEMB, b);
+  return b;
+}
+
+static byte readmenu(byte slot) { // Latest command of user menu slot
+  if (!jindexed) jindex();
+  byte c;
+  EEPROM.get(jmenu[slot] >= 0 ? EEJOURNAL + jmenu[slot] : EEMENU + slot, c);
+  return c;
+}
+
+static uint16_t fletcher16(const byte* p, int n) { // Checksum of program directory
+  uint16_t s1 = 0, s2 = 0;
+  while (n--) {
+    s1 = (s1 + *p++) % 255;
+    s2 = (s2 + s1) % 255;
+  }
+  return s2 << 8 | s1;
+}
+
+static void savedir(void) { // Persist usrptr[], nou and sou so boot needs no flash scan
+  if (usrindexed != nou + 1) return; // Only a terminated list
+  byte d[JDIRSIZE(MAXCMDU - MAXCMDB)];
+  int n = 0;
+  d[n++] = nou;
+  d[n++] = sou; d[n++] = sou >> 8;
+  for (byte k = 0; k < nou; k++) {
+    int off = usrptr[k] - EEUSTART;
+    d[n++] = off; d[n++] = off >> 8;
+    for (byte i = 0; i < PRGNAMEMAX; i++) d[n++] = EEPROM[usrptr[k] + i];
+  }
+  uint16_t c = fletcher16(d, n);
+  d[n++] = c; d[n++] = c >> 8;
+  if (!jappend(JDIR, 0, d, n) && jdir >= 0) EEPROM.put(EEJOURNAL + jdir, (byte)0); // Journal full - void old directory
+}
+
+static boolean loaddir(void) { // Restore program index from the journal - false if missing or stale
+  if (!jindexed) jindex();
+  if (jdir < 0) return false;
+  byte d[JDIRSIZE(MAXCMDU - MAXCMDB)];
+  int at = EEJOURNAL + jdir;
+  d[0] = EEPROM[at];
+  if (d[0] > MAXCMDU - MAXCMDB) return false;
+  int n = JDIRSIZE(d[0]);
+  for (int i = 1; i < n; i++) d[i] = EEPROM[at + i];
+  if (fletcher16(d, n - 2) != (d[n - 2] | d[n - 1] << 8)) return false;
+  const int capacity = userAreaCapacity();
+  int s = d[1] | d[2] << 8, prev = 0;
+  if (s < 2 || s > capacity || EEPROM[EEUSTART + s - 2] != _END || EEPROM[EEUSTART + s - 1] != _END) return false;
+  for (int i = s; i < s + PRGNAMEMAX && i < capacity; i++) if (EEPROM[EEUSTART + i] != 0xFF) return false; // Appended since
+  for (byte k = 0; k < d[0]; k++) { // Programs must still start behind an _END with the same name
+    const byte* e = d + 3 + k * (2 + PRGNAMEMAX);
+    int off = e[0] | e[1] << 8;
+    if (off <= prev || off + PRGNAMEMAX > s - 2 || EEPROM[EEUSTART + off - 1] != _END) return false;
+    for (byte i = 0; i < PRGNAMEMAX; i++) if (EEPROM[EEUSTART + off + i] != e[2 + i]) return false;
+    usrptr[k] = EEUSTART + off;
+    memcpy(usrname[k], e + 2, PRGNAMEMAX);
+    prev = off;
+  }
+  nou = d[0];
+  sou = s;
+  usrptr[nou] = EEUSTART + s - 1;
+  usrindexed = nou + 1;
+  tstale = true;
+  dictstale = true;
+  return true;
 }
 
 /*void eraseEEPROM() {
@@ -4967,6 +5909,8 @@ static boolean printscreen(void) { // Print screen
 }*/
 
 bool eraseEEPROM() {
+    usrcode = nullptr; // Page rotates - drop direct flash view
+    jindexed = false; // New page starts with an empty journal
     bool ok = EEPROM.beginPageRewrite();
     if (!ok && Serial) {
         Serial.println("[EEPROM] Page rotation skipped (writes disabled)");
@@ -4974,28 +5918,47 @@ bool eraseEEPROM() {
     return ok;
 }
 
+static void jlayout(void) { // Boot: keep the journal off while older programs run past EEJOURNAL
+  jlegacy = false;
+  if (loaddir()) return; // Directory in the journal - user area fits
+  jlegacy = true; // Scan the whole page for the _END _END terminator
+  jindexed = false;
+  indexusr([](int i) -> byte { return EEPROM[EEUSTART + i]; }, userAreaCapacity());
+  if (usrindexed == nou + 1 && sou <= EEJOURNAL - EEUSTART) { // Terminated before the journal
+    jlegacy = false;
+    jindexed = false;
+    savedir();
+  }
+}
+
 static int userAreaCapacity() {
-    return EEPROM.length() - EEUSTART;
+    return EEUEND - EEUSTART;
 }
 
-static void snapshotConfig(uint8_t* buffer) {
+static void snapshotConfig(uint8_t* buffer) { // Config region with journal folded in
     for (int i = 0; i < EEUSTART; ++i) {
         EEPROM.get(i, buffer[i]);
     }
+    for (byte i = 0; i < MEMNR; ++i) {
+        double r, im;
+        readconst(i, r, im);
+        memcpy(buffer + EEMEM + i * sizeof(double), &r, sizeof(r));
+        memcpy(buffer + EEMEM + (i + MEMNR) * sizeof(double), &im, sizeof(im));
+    }
+    int64_t b = readbusiness();
+    memcpy(buffer + EEMEMB, &b, sizeof(b));
+    for (byte i = 0; i < MENUITEMS; ++i) buffer[EEMENU + i] = readmenu(i);
 }
 
-static void restoreConfig(const uint8_t* buffer) {
-    // Only write bytes that differ from 0xFF (erased state)
-    // This dramatically reduces unnecessary writes to config area
-    for (int i = 0; i < EEUSTART; ++i) {
-        uint8_t existing;
-        EEPROM.get(i, existing);
-        
-        // Only write if value differs (wear-leveling optimization)
-        if (existing != buffer[i]) {
-            EEPROM.put(i, buffer[i]);
-        }
-    }
+static void jfits(int length) { // Rewritten user area leaves the journal space erased - turn the journal on
+  if (jlegacy && length <= EEJOURNAL - EEUSTART) {
+    jlegacy = false;
+    jindexed = false;
+  }
+}
+
+static void restoreConfig(const uint8_t* buffer) { // Program config region of the freshly rotated page
+    EEPROM.writeImage(0, buffer, EEUSTART); // Erased (0xFF) words are skipped
 }
 
 static bool rewriteUserAreaImage(const uint8_t* userData,
@@ -5032,15 +5995,23 @@ static bool rewriteUserAreaImage(const uint8_t* userData,
         return false;
     }
 
+    if (!overrideConfig && EEPROM.canProgram(EECLEANFLAG, &configBuf[EECLEANFLAG], 1) &&
+        EEPROM.canProgram(EEUSTART, userData, length) && EEPROM.canProgram(EEUSTART + length, nullptr, capacity - length)) {
+        if (Serial) Serial.println(F("[EEPROM] Only 1->0 changes - programming in place"));
+        EEPROM.programRange(EECLEANFLAG, &configBuf[EECLEANFLAG], 1);
+        EEPROM.writeImage(EEUSTART, userData, length);
+        jfits(length);
+        indexusr([&](int i) -> byte { return (i < length) ? userData[i] : 0xFF; }, capacity);
+        savedir();
+        return true;
+    }
+
     if (!eraseEEPROM()) {
         Serial.println(F("[EEPROM] Rewrite aborted: unable to rotate page"));
         return false;
     }
     restoreConfig(configBuf);
-    for (int i = 0; i < capacity; ++i) {
-        uint8_t value = (i < length) ? userData[i] : 0xFF;
-        EEPROM.put(EEUSTART + i, value);
-    }
+    EEPROM.writeImage(EEUSTART, userData, length); // Rest of the user area stays erased
     
     if (Serial) {
         Serial.println(F("[EEPROM] Write complete, reading back first 32 bytes:"));
@@ -5052,7 +6023,10 @@ static bool rewriteUserAreaImage(const uint8_t* userData,
         }
         Serial.println();
     }
-    
+
+    jfits(length);
+    indexusr([&](int i) -> byte { return (i < length) ? userData[i] : 0xFF; }, capacity); // Index from RAM image
+    savedir();
     return true;
 }
 
@@ -5094,6 +6068,8 @@ static void warnIfConstantSlotOutOfRange(byte slot, const char* region, uint32_t
 
 static bool commitConstantSlot(byte slot, const struct data& value) {
     if (slot >= MEMNR) return false;
+    double payload[2] = {value.r, value.i};
+    if (jappend(JCONST, slot, payload)) return true;
 
     uint8_t configBuf[EEUSTART];
     snapshotConfig(configBuf);
@@ -5114,6 +6090,7 @@ static bool commitConstantSlot(byte slot, const struct data& value) {
 }
 
 static bool commitBusinessSlot(int64_t businessValue) {
+    if (jappend(JBUS, 0, &businessValue)) return true;
     uint8_t configBuf[EEUSTART];
     snapshotConfig(configBuf);
     memcpy(configBuf + EEMEMB, &businessValue, sizeof(businessValue));
@@ -5129,6 +6106,7 @@ static bool commitBusinessSlot(int64_t businessValue) {
 
 static bool commitMenuSlot(byte slot, byte cmdId) {
     if (slot >= MENUITEMS) return false;
+    if (jappend(JMENU, slot, &cmdId)) return true;
     uint8_t configBuf[EEUSTART];
     snapshotConfig(configBuf);
     configBuf[EEMENU + slot] = cmdId;
@@ -5486,6 +6464,7 @@ void setup() {
     Serial.println("SSD1306 init failed");
     while (true) { }  // hang if display not found
   }
+  keyinit(); // Keyboard rows sense key presses from now on
 
   //--------------------------------------------------------------------
   //Show a build screen and some features
@@ -5522,6 +6501,8 @@ void setup() {
     dumpUserHeader();
   }
   
+  jlayout(); // Before the user area is used - older programs may reach into the journal
+
 #ifndef DONT_CLEAR_USER_FUNCTIONS
   uint8_t firstUserByte;
   uint8_t secondUserByte;
@@ -5574,10 +6555,140 @@ void setup() {
 
 #if ENABLE_WRITE_COUNTERS
   Serial.println(F("\n[WEAR-LEVELING] Diagnostics enabled. Send 'S' for stats, 'R' to reset."));
+#endif
+#if MATH_COMPARE
+  mathcompare();
 #endif
   Serial.println("Setup complete.");
 }
 
+static void runstep(void) { // Fetch and execute one program step at mp
+#if THREADED_CODE
+  if (tstep()) return;
+#endif
+  if (mp < sizeof(mem) + sou) key = fetchcode(mp++); // Builtin or user
+  else mp = 0; // cmd > MAXCMDU
+  
+  // log program execution steps
+  #if LOG_PRG_MEMPTR
+  if (Serial && key != 255) {
+    Serial.print("[PRG] mp="); Serial.print(mp);
+    Serial.print(" key="); Serial.print(key);
+    Serial.print(" dp="); Serial.println(dp);
+    Serial.flush(); // Force output
+  }
+  #endif
+  
+#if LOG_FX_FI_STACK
+  if (Serial && key != _END && key < NOPRINTNOKEY) {
+    Serial.print("[EXEC_STEP] cmd="); Serial.print(key);
+    if (key < MAXCMDB && key < sizeof(cmd)/sizeof(cmd[0])) {
+      Serial.print(" name="); Serial.print(cmd[key]);
+    }
+    Serial.print(" BEFORE - dp="); Serial.print(dp);
+    Serial.print(" ap="); Serial.print(ap);
+    Serial.print(" STACK: ");
+    for (byte i = 0; i < dp && i < 6; i++) {
+      Serial.print(ds[i].r, 3); Serial.print(" ");
+    }
+    Serial.println();
+    Serial.flush();
+  }
+#endif
+  
+  if (key >= MAXCMDB && key != _END) apush(mp); // Subroutine detected - branch (only user programs, not builtin RAM commands)
+  if (key == _END) { // _END reached
+#if LOG_FX_FI_STACK
+    if (Serial) {
+      Serial.print("[EXEC_END] ap="); Serial.print(ap);
+      Serial.print(" dp="); Serial.print(dp);
+      Serial.print(" STACK: ");
+      for (byte i = 0; i < dp && i < 6; i++) {
+        Serial.print(ds[i].r, 3); Serial.print(" ");
+      }
+      Serial.println();
+    }
+#endif
+    if (ap) mp = apop(); // End of subroutine - return
+    else { // End of run
+      mp = 0;
+      isprintscreen = true; // Finally print screen
+      #if LOG_PRG_MEMPTR
+        if (Serial) Serial.println("[PRG] Program END - execution complete");
+      #endif
+    }
+  }
+  else {
+#if LOG_RAM_STORCL
+    if (Serial && (key == _STO_RAM || key == _RCL_RAM)) {
+      Serial.print("[LOOP] About to execute cmd=");
+      Serial.print(key == _STO_RAM ? "STO_RAM" : "RCL_RAM");
+      Serial.print(" dp="); Serial.print(dp);
+      Serial.print(" isnewnumber="); Serial.println(isnewnumber);
+    }
+#endif
+#if LOG_PRG_MEMPTR
+    if (Serial && key == _RCL) {
+      Serial.println("[PRG] *** ABOUT TO EXECUTE RCL ***");
+    }
+#endif
+    execute(key);
+#if LOG_FX_FI_STACK
+    if (Serial && key < NOPRINTNOKEY) {
+      Serial.print("[EXEC_STEP] AFTER - dp="); Serial.print(dp);
+      Serial.print(" ap="); Serial.print(ap);
+      Serial.print(" STACK: ");
+      for (byte i = 0; i < dp && i < 6; i++) {
+        Serial.print(ds[i].r, 3); Serial.print(" ");
+      }
+      Serial.println();
+      Serial.flush();
+    }
+#endif
+#if LOG_PRG_MEMPTR
+    if (Serial && key == _RCL) {
+      Serial.println("[PRG] *** RCL EXECUTE DONE ***");
+    }
+#endif
+#if LOG_RAM_STORCL
+    if (Serial && (key == _STO_RAM || key == _RCL_RAM)) {
+      Serial.print("[LOOP] After execute dp="); Serial.print(dp);
+      Serial.print(" isnewnumber="); Serial.println(isnewnumber);
+    }
+#endif
+  }
+}
+
+static boolean keylongpress(byte k) { // Press of k taken last lasts longer than FLONGPRESSTIME
+  for (byte i = keyqtail; i != keyqhead; i = (i + 1) & (KEYQUEUE - 1)) // Typed ahead - its release is queued
+    if (keyq[i].key == k && !keyq[i].down) return keyq[i].ms - keydownms > FLONGPRESSTIME;
+  return keystable == k && millis() - keydownms > FLONGPRESSTIME; // Still held
+}
+
+static byte nextevent(void) { // Collect due event sources - idle if none is pending
+  keypoll();
+  unsigned long now = millis();
+  byte ev = 0;
+  if (keypending() || (keylevel != NOPRINTNOKEY && now - lastkeyscan >= KEYSCANMS)) { // Key change or key held
+    lastkeyscan = now;
+    ev |= EVKEY;
+  }
+  if (now - lasttick >= TICKMS) {
+    lasttick = now;
+    ev |= EVTICK;
+  }
+  if (issolve) ev |= EVCOMPUTE;
+  if (isprintscreen && now - lastredraw >= eachframemillis) {
+    lastredraw = now;
+    ev |= EVREDRAW;
+  }
+  if (!ev && !mp) { // Nothing to do until the next key scan or row interrupt
+    if (KEYSCANMS - (now - keyscanms) > EEPROM_PARTIAL_ERASE_MS && EEPROM.preEraseStep()) return ev; // Erase next page ahead
+    idle();
+  }
+  return ev;
+}
+
 void loop() {
   //Serial.print("MAGIC: "); Serial.println(digitalRead(MAGICKEYPIN));
 
@@ -5613,119 +6724,26 @@ void loop() {
   }
 #endif
 
-  if (isprintscreen) isprintscreen = printscreen(); // Print screen
+  byte ev = nextevent(); // Due event sources
+  if (ev & EVREDRAW) isprintscreen = printscreen(); // Print screen
   if (pause) { // Pause
     delaylong(pause);
     pause = 0;
   }
 
-  if (mp) { // *** Execute/run code
-    if (mp < sizeof(mem)) key = mem[mp++]; // Builtin
-    else if (mp < sizeof(mem) + sou){
-      byte tmp;
-      EEPROM.get(mp - sizeof(mem) + EEUSTART, tmp); // read from EEPROM
-      key = tmp;                                    // assign to key
-      mp++;                                         // post-increment
-    }
-    else mp = 0; // cmd > MAXCMDU
-    
-    // log program execution steps
-    #if LOG_PRG_MEMPTR
-    if (Serial && key != 255) {
-      Serial.print("[PRG] mp="); Serial.print(mp);
-      Serial.print(" key="); Serial.print(key);
-      Serial.print(" dp="); Serial.println(dp);
-      Serial.flush(); // Force output
-    }
-    #endif
-    
-#if LOG_FX_FI_STACK
-    if (Serial && key != _END && key < NOPRINTNOKEY) {
-      Serial.print("[EXEC_STEP] cmd="); Serial.print(key);
-      if (key < MAXCMDB && key < sizeof(cmd)/sizeof(cmd[0])) {
-        Serial.print(" name="); Serial.print(cmd[key]);
-      }
-      Serial.print(" BEFORE - dp="); Serial.print(dp);
-      Serial.print(" ap="); Serial.print(ap);
-      Serial.print(" STACK: ");
-      for (byte i = 0; i < dp && i < 6; i++) {
-        Serial.print(ds[i].r, 3); Serial.print(" ");
-      }
-      Serial.println();
-      Serial.flush();
-    }
-#endif
-    
-    if (key >= MAXCMDB && key != _END) apush(mp); // Subroutine detected - branch (only user programs, not builtin RAM commands)
-    if (key == _END) { // _END reached
-#if LOG_FX_FI_STACK
-      if (Serial) {
-        Serial.print("[EXEC_END] ap="); Serial.print(ap);
-        Serial.print(" dp="); Serial.print(dp);
-        Serial.print(" STACK: ");
-        for (byte i = 0; i < dp && i < 6; i++) {
-          Serial.print(ds[i].r, 3); Serial.print(" ");
-        }
-        Serial.println();
-      }
-#endif
-      if (ap) mp = apop(); // End of subroutine - return
-      else { // End of run
-        mp = 0;
-        isprintscreen = true; // Finally print screen
-        #if LOG_PRG_MEMPTR
-          if (Serial) Serial.println("[PRG] Program END - execution complete");
-        #endif
-      }
-    }
-    else {
-#if LOG_RAM_STORCL
-      if (Serial && (key == _STO_RAM || key == _RCL_RAM)) {
-        Serial.print("[LOOP] About to execute cmd=");
-        Serial.print(key == _STO_RAM ? "STO_RAM" : "RCL_RAM");
-        Serial.print(" dp="); Serial.print(dp);
-        Serial.print(" isnewnumber="); Serial.println(isnewnumber);
-      }
-#endif
-#if LOG_PRG_MEMPTR
-      if (Serial && key == _RCL) {
-        Serial.println("[PRG] *** ABOUT TO EXECUTE RCL ***");
-      }
-#endif
-      execute(key);
-#if LOG_FX_FI_STACK
-      if (Serial && key < NOPRINTNOKEY) {
-        Serial.print("[EXEC_STEP] AFTER - dp="); Serial.print(dp);
-        Serial.print(" ap="); Serial.print(ap);
-        Serial.print(" STACK: ");
-        for (byte i = 0; i < dp && i < 6; i++) {
-          Serial.print(ds[i].r, 3); Serial.print(" ");
-        }
-        Serial.println();
-        Serial.flush();
-      }
-#endif
-#if LOG_PRG_MEMPTR
-      if (Serial && key == _RCL) {
-        Serial.println("[PRG] *** RCL EXECUTE DONE ***");
-      }
-#endif
-#if LOG_RAM_STORCL
-      if (Serial && (key == _STO_RAM || key == _RCL_RAM)) {
-        Serial.print("[LOOP] After execute dp="); Serial.print(dp);
-        Serial.print(" isnewnumber="); Serial.println(isnewnumber);
-      }
-#endif
-    }
-    digitalWrite(KEYBOARDCOL1, LOW); // Stop by pressing C
-    if (!digitalRead(KEYBOARDROW4)) mp = ap = 0;
-    digitalWrite(KEYBOARDCOL1, HIGH);
+  if (mp) { // *** Execute/run code in time slices
+    unsigned long slice = millis();
+    uint16_t steps = 0;
+    do {
+      runstep();
+      if (!(++steps % RUNBATCH) && millis() - slice >= RUNSLICEMS) break; // Time for keys and screen
+    } while (mp && !pause && !(isprintscreen && millis() - lastredraw >= eachframemillis)); // Until a redraw is due
+    if (abortRequested()) mp = ap = 0; // Stop by pressing C
   }
 
-  else { // *** Evaluate valid new key
-    if (!(nextFrame())) return; // Idle for next frame
-    key = getkey(); // READ KEY
-    if (key < NOPRINTNOKEY) { // only if valid key otherwise flooding with NOPRINTNOKEY
+  else if (ev & (EVKEY | EVTICK | EVCOMPUTE)) { // *** Evaluate valid new key, solver, clock and power
+    if (ev & EVKEY) key = getkey(); // READ KEY
+    if ((ev & EVKEY) && key < NOPRINTNOKEY) { // only if valid key otherwise flooding with NOPRINTNOKEY
       Serial.print("Key read: ");
       Serial.println(key);
       // Debug matrix pins
@@ -5733,14 +6751,14 @@ void loop() {
       Serial.print(" ROW4: "); Serial.println(digitalRead(KEYBOARDROW4));
     }
 
-    if (key == KEY13) { // Stop execution
+    if ((ev & EVKEY) && key == KEY13) { // Stop execution
       issolve = isint =  isplot = istorch = false;
       gkResetController();
       clockState.active = false; // Stop clock
       powertimestamp = millis(); // Reset power management timer
     }
-    if (key == KEY1 && !base) { // Check MENU (longpressed f)
-      if (millis() - timestamp > FLONGPRESSTIME) {
+    if ((ev & EVKEY) && key == KEY1 && !base) { // Check MENU (longpressed f)
+      if (keylongpress(KEY1)) {
         if (isprgedit) { // Menu from prgedit demanded
           isprgmenu = true; isprgedit = false;
         }
@@ -5749,12 +6767,12 @@ void loop() {
           freleased = false;
         }
         ismenu = isprintscreen = true;
+        oldkey = key; // Typed-ahead press - wait for its release before selecting
         sel = 0; // Comment out, if menu should't start at 0
       }
     }
-    else timestamp = millis();
 
-    if (millis() - powertimestamp > darktime * 10000L) { // Dark if no activity
+    if ((ev & EVTICK) && millis() - powertimestamp > darktime * 10000L) { // Dark if no activity
       // Don't sleep if clock is active - keep device running to maintain clock accuracy
       if (!clockState.active) {
         Serial.print("[POWER] Screen timeout after ");
@@ -5771,7 +6789,7 @@ void loop() {
       powertimestamp = millis();
     }
 
-    if (issolve) { // # SOLVE
+    if (ev & EVCOMPUTE) { // # SOLVE
       cycles++;
 
       dp = 0; // Clear stack for new solve
@@ -5806,188 +6824,20 @@ void loop() {
         isprintscreen = true;
       }
     }
-    else if (isint) { // # INTEGRATE - Adaptive Gauss-Kronrod
-      if (!gkController.active) {
-        isint = false;
-      }
-      else {
-        cycles++;
-#if LOG_FX_FI_STACK
-        if (Serial) {
-          Serial.print("[FI] BEFORE execute - eval#"); Serial.print(gkEvalCount + 1);
-          Serial.print(" node="); Serial.print((int)gkController.nodeIndex);
-          Serial.print(" x="); Serial.print(gkCurrentNodePosition(), 8);
-          Serial.print(" dp="); Serial.print(dp);
-          Serial.print(" ap="); Serial.print(ap);
-          Serial.print(" STACK: ");
-          for (byte i = 0; i < dp && i < 8; i++) {
-            Serial.print("["); Serial.print(i); Serial.print("]=");
-            Serial.print(ds[i].r, 6);
-            if (ds[i].i != 0.0) {
-              Serial.print("+j"); Serial.print(ds[i].i, 6);
-            }
-            Serial.print(" ");
-          }
-          Serial.println();
-        }
-#endif
-        execute(MAXCMDB); // Evaluate user function at current x value
-#if LOG_FX_FI_STACK
-        if (Serial) {
-          Serial.print("[FI] AFTER execute - dp="); Serial.print(dp);
-          Serial.print(" ap="); Serial.print(ap);
-          Serial.print(" STACK: ");
-          for (byte i = 0; i < dp && i < 8; i++) {
-            Serial.print("["); Serial.print(i); Serial.print("]=");
-            Serial.print(ds[i].r, 6);
-            if (ds[i].i != 0.0) {
-              Serial.print("+j"); Serial.print(ds[i].i, 6);
-            }
-            Serial.print(" ");
-          }
-          Serial.println();
-        }
-#endif
-        double fx = dpoprd();
-#if LOG_FX_FI_STACK
-        if (Serial) {
-          Serial.print("[FI] AFTER dpoprd - fx="); Serial.print(fx, 8);
-          Serial.print(" dp="); Serial.print(dp);
-          Serial.print(" STACK: ");
-          for (byte i = 0; i < dp && i < 8; i++) {
-            Serial.print("["); Serial.print(i); Serial.print("]=");
-            Serial.print(ds[i].r, 6); Serial.print(" ");
-          }
-          Serial.println();
-        }
-#endif
-        gkEvalCount++;
-        uint8_t node = gkController.nodeIndex;
-        gkController.kronrodSum += gk_weights[node] * fx;
-        if (gk_gauss_weights[node] != 0.0) gkController.gaussSum += gk_gauss_weights[node] * fx;
-        gkController.nodeIndex++;
-
-        if (gkController.nodeIndex < GK_POINTS) {
-          dpushr(gkCurrentNodePosition());
-        }
-        else {
-          double kronrodEstimate = gkController.kronrodSum * gkController.halfwidth;
-          double gaussEstimate = gkController.gaussSum * gkController.halfwidth;
-          double localError = _abs(kronrodEstimate - gaussEstimate);
-          gkController.lastError = max(gkController.lastError, localError);
-          gkRecordIntervalStats();
-          double adaptiveTol = max(gkController.current.tol, gkController.targetRelTol * _abs(kronrodEstimate));
-          bool accept = (localError <= adaptiveTol) ||
-                        (gkController.current.depth >= GK_MAX_DEPTH) ||
-                        (gkController.halfwidth <= GK_MIN_INTERVAL);
-
-          bool aborted = false;
-          gkLogProgress("estimate", localError, adaptiveTol, accept);
-          if (accept) {
-            gkController.total += kronrodEstimate;
-          }
-          else {
-            double mid = 0.5 * (gkController.current.a + gkController.current.b);
-            double childTol = gkController.current.tol * 0.5;
-            gkRefinementCount++;
-            bool pushOk = gkPushInterval(mid, gkController.current.b, childTol, gkController.current.depth + 1) &&
-                          gkPushInterval(gkController.current.a, mid, childTol, gkController.current.depth + 1);
-            if (!pushOk) {
-              gkLogProgress("overflow", localError, adaptiveTol, false);
-              gkResetController();
-              isint = false;
-              msgnr = MSGOVERFLOW;
-              isprintscreen = true;
-              aborted = true;
-            }
-          }
-
-          if (aborted) {
-            // Integration aborted due to stack overflow
-          }
-          else if (gkStartNextInterval()) {
-            dpushr(gkCurrentNodePosition());
-          }
-          else {
-            double finalResult = gkController.orientation * gkController.total;
-            if (Serial) {
-              Serial.print("Adaptive GK complete. result="); Serial.print(finalResult);
-              Serial.print(" maxErr="); Serial.print(gkController.lastError);
-              Serial.print(" evals="); Serial.print(gkEvalCount);
-              Serial.print(" refinements="); Serial.println(gkRefinementCount);
-            }
-            dpushr(localError); // Push estimated error
-            dpushr(finalResult); // Push final result
-#if LOG_FX_FI_STACK
-            if (Serial) {
-              Serial.print("[FI] INTEGRATION COMPLETE - finalResult="); Serial.print(finalResult, 8);
-              Serial.print(" dp="); Serial.print(dp);
-              Serial.print(" FINAL STACK: ");
-              for (byte i = 0; i < dp && i < 8; i++) {
-                Serial.print("["); Serial.print(i); Serial.print("]=");
-                Serial.print(ds[i].r, 6); Serial.print(" ");
-              }
-              Serial.println();
-            }
-#endif
-            mp = 0;
-            isnewnumber = true;
-            isint = false;
-            gkResetController();
-            isprintscreen = true;
-          }
-        }
-      }
+    if ((ev & EVTICK) && clockState.active) { // # CLOCK
+      clockUpdate();
     }
-    if (isplotcalc) { // # PLOT
-#if LOG_PLOT
-      Serial.print("[PLOT] state cycle="); Serial.print(cycles);
-      Serial.print(" inflight="); Serial.print(isplotEvalInFlight ? "y" : "n");
-      Serial.print(" dp="); Serial.print(dp);
-      if (dp) {
-        Serial.print(" tos="); Serial.print(ds[dp - 1].r, 10);
-      }
-      Serial.println();
-#endif
-
-      // If a previous evaluation finished, capture its result first
-      if (isplotEvalInFlight) {
-        if (cycles < GRAPH_PIXEL_WIDTH) {
-          double y = dpopr();
-          plot[cycles] = y;
-#if LOG_PLOT
-          Serial.print("[PLOT] captured y["); Serial.print(cycles);
-          Serial.print("]="); Serial.println(y, 10);
-#endif
-          cycles++;
-        }
-        isplotEvalInFlight = false;
-      }
-
-      if (cycles >= GRAPH_PIXEL_WIDTH) {
-        isplotcalc = false;
-        isplot = true; // Ready to render
-        isprintscreen = true; // Force display refresh immediately
-#if LOG_PLOT
-        Serial.println("[PLOT] sampling complete, ready to render");
-#endif
-      }
-      else if (!isplotEvalInFlight) {
-        double nextX = plota + cycles * plotd;
-        dpushr(nextX);
-        execute(MAXCMDB);
-        isplotEvalInFlight = true;
-#if LOG_PLOT
-        Serial.print("[PLOT] launched eval for x="); Serial.println(nextX, 10);
+    if ((ev & EVKEY) && clockState.active && key < NOPRINTNOKEY && key != oldkey) { // Any key stops the clock
+      oldkey = key;
+#if LOG_CLOCK
+      Serial.println("[CLK] Key pressed, stopping clock");
 #endif
-      }
-    }
-    
-    if (clockState.active) { // # CLOCK
-      clockUpdate();
+      clockState.active = false;
+      powertimestamp = millis(); // Reset power management timer
+      isprintscreen = true;
     }
 
-    if (key != oldkey) {
+    if ((ev & EVKEY) && key != oldkey) {
       oldkey = key; // New valid key is old key
       freleased = true;
       if (key < NOPRINTNOKEY) {
@@ -6002,9 +6852,7 @@ void loop() {
         Serial.println("s)");
 
         if (isgetkey) { // ### Get keypress
-          byte k;
-          while ((k = getkey()) >= NOPRINTNOKEY) ; // Wait for keypress
-          dpushr(k - '0');
+          dpushr(key - '0');
           isgetkey = false;
         }
 
@@ -6053,8 +6901,7 @@ void loop() {
                 Serial.println(setusrselect);
                 logUserMenuCommand("assign", setusrselect);
 #endif
-                byte currentValue = 0xFF;
-                EEPROM.get(EEMENU + tmp, currentValue);
+                byte currentValue = readmenu(tmp);
                 bool writeOk = true;
                 if (currentValue != setusrselect)
                   writeOk = commitMenuSlot(tmp, setusrselect);
@@ -6062,8 +6909,7 @@ void loop() {
                   msgnr = MSGSAVE;
                 }
 #if LOG_USER_MENU
-                byte verify = 0;
-                EEPROM.get(EEMENU + tmp, verify);
+                byte verify = readmenu(tmp);
                 Serial.print("[USR_MENU] slot ");
                 Serial.print(tmp);
                 Serial.print(" verified cmdId ");
@@ -6073,14 +6919,12 @@ void loop() {
                 ismenusetusr = false;
               }
               else if (isprgmenu) { // Go back to prgedit
-                byte value; 
-                EEPROM.get(EEMENU + tmp, value);  // read byte from EEPROM 
+                byte value = readmenu(tmp);
                 prgstepins(value);                // pass to function 
                 isprgmenu = false; isprgedit = true;
               }
               else { // Execute selected command
-                byte value; 
-                EEPROM.get(EEMENU + tmp, value); 
+                byte value = readmenu(tmp);
 #if LOG_USER_MENU
                 Serial.print("[USR_MENU] execute slot ");
                 Serial.print(tmp);
@@ -6181,6 +7025,7 @@ void loop() {
               sort();
             }
             prgbuflen = nr;
+            verifyprg();
             isprgnew = isprgedit = true; isprgselect = false;
           }
           else if (key == KEY7) { // # 5 - save program (out)
@@ -6323,6 +7168,7 @@ void loop() {
           }
           else if (key <= KEY4 || key == KEY16) prgstepins(key - '0'); // # Insert direct key
           else if (key == KEY13) { // # Escape and save program to EEPROM
+            verifyprg(); // Flag unbalanced IF/ELSE/THEN and BEGIN/UNTIL or a floating stack - the program is saved anyway
             if (isprgnew) { // Save new program
               Serial.println("=== NEW PROGRAM SAVE START ===");
               Serial.print("sou="); Serial.print(sou);
@@ -6381,10 +7227,7 @@ void loop() {
                 }
 
                 // Save program buffer to EEPROM
-                for (int i = 0; i < prgbuflen; i++) {
-                  uint8_t stepByte = prgbuf[i];
-                  EEPROM.put(newPrgAddr + PRGNAMEMAX + i, stepByte);
-                }
+                EEPROM.programRange(newPrgAddr + PRGNAMEMAX, prgbuf, prgbuflen);
 
                 // Add 2 x _END markers (program terminator + list terminator)
                 const int firstEndAddr = newPrgAddr + PRGNAMEMAX + prgbuflen;
@@ -6415,6 +7258,8 @@ void loop() {
                 }
                 Serial.println();
 
+                appendusr(newPrgAddr, prgbuflen); // Index new program
+
                 // Sort programs (unchanged)
                 Serial.println("Calling sort()...");
                 sort();